@@ -0,0 +1,235 @@
+//)Analytics accumulates corpus statistics while files are decoded, without printing anything per note:
+//// pitch-class and octave histograms, key signature, tempo and time signature distributions,
+//// a polyphony profile and a note duration distribution
+//)each worker thread keeps its own Analytics and listens to every file it parses;
+//// when the workers are done, their Analytics are merged into one and printed as a single summary
+//)polyphony is measured per track (the number of notes already sounding in the track when a note starts),
+//// since tracks are decoded one after another rather than merged in time
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "MIDInotes.h"
+#include "MIDIparser.h"
+
+class Analytics : public NoteListener, public MetaListener
+{
+public:
+    //durations are counted in power-of-two bins, from a 32nd note or less up to 64 quarter notes or more
+    static constexpr int duration_bins{ 10 };
+
+    void setDivision(short quarter_note) override
+    {
+        m_quarter_note = ( quarter_note > 0 ? quarter_note : 1 );
+        ++m_files;
+    }
+
+    //polyphony is counted per track, and a file that stopped early (over --max-memory, say) never finished its notes
+    void trackStarted() override { m_sounding = 0; }
+
+    void noteStarted(const MIDInote& note) override;
+
+    void noteFinished(const MIDInote& note) override;
+
+    void tempoChange(long tick, double bpm) override;
+
+    void timeSignature(long tick, int numerator, int denominator) override;
+
+    void keySignature(long tick, int sharps, bool minor) override;
+
+    //reduction step: fold another worker's totals into this one
+    void merge(const Analytics& other);
+
+    friend std::ostream& operator<< (std::ostream& out, const Analytics& a);
+
+private:
+    short m_quarter_note{ 1 };
+
+    long m_files{ 0 };
+    long m_notes{ 0 };
+
+    std::array<long, 12> m_pitch_classes{};
+
+    //octaves -1 through 9
+    std::array<long, 11> m_octaves{};
+
+    //key signatures by number of sharps (-7 through 7), major and minor
+    std::array<std::array<long, 2>, 15> m_keys{};
+
+    std::map<std::pair<int, int>, long> m_time_signatures{};
+
+    long m_tempos{ 0 };
+    double m_min_bpm{ std::numeric_limits<double>::max() };
+    double m_max_bpm{ 0.0 };
+    double m_total_bpm{ 0.0 };
+
+    //m_polyphony[n] counts the notes that started while n other notes in the track were sounding
+    std::vector<long> m_polyphony{};
+    int m_sounding{ 0 };
+
+    std::array<long, duration_bins> m_durations{};
+};
+
+//define Analytics member functions
+
+inline void Analytics::noteStarted(const MIDInote& note)
+{
+    Pitch8ve p8{ note.getPitch() };
+
+    ++m_pitch_classes[ p8.pitch() ];
+    ++m_octaves[ std::clamp(p8.octave() + 1, 0, 10) ];
+
+    if ( std::size(m_polyphony) <= static_cast<std::size_t>(m_sounding) )
+        m_polyphony.resize( m_sounding + 1 );
+
+    ++m_polyphony[ m_sounding ];
+    ++m_sounding;
+    ++m_notes;
+}
+
+inline void Analytics::noteFinished(const MIDInote& note)
+{
+    if ( m_sounding > 0 )
+        --m_sounding;
+
+    //bin 0 is a 32nd note or less, bin 3 a quarter note, bin 9 64 quarter notes or more
+    long thirty_seconds{ note.duration() * 8 / m_quarter_note };
+
+    int bin{ 0 };
+
+    while ( bin < duration_bins - 1 && thirty_seconds > 1 )
+    {
+        thirty_seconds /= 2;
+        ++bin;
+    }
+
+    ++m_durations[bin];
+}
+
+inline void Analytics::tempoChange(long, double bpm)
+{
+    ++m_tempos;
+    m_min_bpm = std::min( m_min_bpm, bpm );
+    m_max_bpm = std::max( m_max_bpm, bpm );
+    m_total_bpm += bpm;
+}
+
+inline void Analytics::timeSignature(long, int numerator, int denominator)
+{
+    ++m_time_signatures[ { numerator, denominator } ];
+}
+
+inline void Analytics::keySignature(long, int sharps, bool minor)
+{
+    if ( sharps >= -7 && sharps <= 7 )
+        ++m_keys[ sharps + 7 ][ minor ];
+}
+
+inline void Analytics::merge(const Analytics& other)
+{
+    m_files += other.m_files;
+    m_notes += other.m_notes;
+
+    for ( std::size_t i{ 0 }; i < std::size(m_pitch_classes); ++i )
+        m_pitch_classes[i] += other.m_pitch_classes[i];
+
+    for ( std::size_t i{ 0 }; i < std::size(m_octaves); ++i )
+        m_octaves[i] += other.m_octaves[i];
+
+    for ( std::size_t i{ 0 }; i < std::size(m_keys); ++i )
+    {
+        m_keys[i][0] += other.m_keys[i][0];
+        m_keys[i][1] += other.m_keys[i][1];
+    }
+
+    for ( const auto& [sig, count] : other.m_time_signatures )
+        m_time_signatures[sig] += count;
+
+    m_tempos += other.m_tempos;
+    m_min_bpm = std::min( m_min_bpm, other.m_min_bpm );
+    m_max_bpm = std::max( m_max_bpm, other.m_max_bpm );
+    m_total_bpm += other.m_total_bpm;
+
+    if ( std::size(m_polyphony) < std::size(other.m_polyphony) )
+        m_polyphony.resize( std::size(other.m_polyphony) );
+
+    for ( std::size_t i{ 0 }; i < std::size(other.m_polyphony); ++i )
+        m_polyphony[i] += other.m_polyphony[i];
+
+    for ( std::size_t i{ 0 }; i < std::size(m_durations); ++i )
+        m_durations[i] += other.m_durations[i];
+}
+
+inline std::ostream& operator<< (std::ostream& out, const Analytics& a)
+{
+    out << "Files: " << a.m_files << '\n';
+    out << "Notes: " << a.m_notes << '\n';
+
+    out << "\nPitch classes:\n";
+
+    for ( int p{ 0 }; p < 12; ++p )
+        out << '\t' << toPitch(p) << ": " << a.m_pitch_classes[p] << '\n';
+
+    out << "\nOctaves:\n";
+
+    for ( int o{ 0 }; o < 11; ++o )
+    {
+        if ( a.m_octaves[o] )
+            out << '\t' << o - 1 << ": " << a.m_octaves[o] << '\n';
+    }
+
+    out << "\nKey signatures:\n";
+
+    for ( int k{ 0 }; k < 15; ++k )
+    {
+        if ( a.m_keys[k][0] )
+            out << '\t' << toKey(k - 7) << " Major: " << a.m_keys[k][0] << '\n';
+
+        if ( a.m_keys[k][1] )
+            out << '\t' << toKey(k - 7) << " minor: " << a.m_keys[k][1] << '\n';
+    }
+
+    out << "\nTime signatures:\n";
+
+    for ( const auto& [sig, count] : a.m_time_signatures )
+        out << '\t' << sig.first << '/' << sig.second << ": " << count << '\n';
+
+    out << "\nTempo: ";
+
+    if ( a.m_tempos )
+    {
+        out << a.m_min_bpm << " - " << a.m_max_bpm << " BPM (mean " << a.m_total_bpm / a.m_tempos
+            << " over " << a.m_tempos << " tempo events)\n";
+    }
+    else
+    {
+        out << "no tempo events\n";
+    }
+
+    out << "\nPolyphony (notes sounding at each note start):\n";
+
+    for ( std::size_t n{ 0 }; n < std::size(a.m_polyphony); ++n )
+    {
+        if ( a.m_polyphony[n] )
+            out << '\t' << n + 1 << ": " << a.m_polyphony[n] << '\n';
+    }
+
+    out << "\nDurations (in quarter notes):\n";
+
+    constexpr std::array<std::string_view, Analytics::duration_bins> bins{
+        "<= 1/8", "1/4", "1/2", "1", "2", "4", "8", "16", "32", ">= 64"
+    };
+
+    for ( int b{ 0 }; b < Analytics::duration_bins; ++b )
+        out << '\t' << bins[b] << ": " << a.m_durations[b] << '\n';
+
+    return out;
+}
@@ -0,0 +1,218 @@
+//)a ControlLane stores the (tick, value) events of one controller on one channel of one track,
+//// delta-encoded: every event but the first of each block of 64 is two variable-length numbers,
+//// the ticks since the previous event and the (zigzag-encoded) change in value, so a dense CC stream
+//// takes about two bytes per event
+//)the first event of every block is kept whole as a checkpoint; valueAt() binary searches the checkpoints
+//// and then decodes at most one block, so lookups are O(log n)
+//)ControlLanes listens to the parser and keeps a lane for every (track, channel, lane) that has events
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "MIDIparser.h"
+
+class ControlLane
+{
+public:
+    static constexpr std::size_t block{ 64 };
+
+    //ticks must not go backwards (they are relative to the start of the lane's track)
+    void add(long tick, int value);
+
+    //the value of the last event at or before tick, or fallback if there isn't one
+    int valueAt(long tick, int fallback=0) const;
+
+    std::size_t size() const { return m_count; }
+
+    int lastValue() const { return m_value; }
+
+    std::size_t memoryUsage() const
+    {
+        return m_data.capacity() + m_checkpoints.capacity() * sizeof(Checkpoint);
+    }
+
+    void shrink()
+    {
+        m_data.shrink_to_fit();
+        m_checkpoints.shrink_to_fit();
+    }
+
+private:
+    struct Checkpoint
+    {
+        long tick{};
+        int value{};
+
+        //offset in m_data of the event after the checkpoint
+        std::uint32_t offset{};
+    };
+
+    void putNumber(std::uint32_t n);
+
+    static std::uint32_t getNumber(const std::vector<std::uint8_t>& data, std::size_t& offset);
+
+    std::vector<std::uint8_t> m_data{};
+    std::vector<Checkpoint> m_checkpoints{};
+
+    long m_tick{ 0 };
+    int m_value{ 0 };
+    std::size_t m_count{ 0 };
+};
+
+//define ControlLane member functions
+
+inline void ControlLane::putNumber(std::uint32_t n)
+{
+    while ( n >= 0x80 )
+    {
+        m_data.push_back( static_cast<std::uint8_t>( (n & 0x7F) | 0x80 ) );
+        n >>= 7;
+    }
+
+    m_data.push_back( static_cast<std::uint8_t>(n) );
+}
+
+inline std::uint32_t ControlLane::getNumber(const std::vector<std::uint8_t>& data, std::size_t& offset)
+{
+    std::uint32_t n{ 0 };
+    int shift{ 0 };
+
+    while ( data[offset] & 0x80 )
+    {
+        n |= static_cast<std::uint32_t>( data[offset++] & 0x7F ) << shift;
+        shift += 7;
+    }
+
+    n |= static_cast<std::uint32_t>( data[offset++] ) << shift;
+
+    return n;
+}
+
+inline void ControlLane::add(long tick, int value)
+{
+    if ( m_count % block == 0 )
+    {
+        m_checkpoints.push_back( Checkpoint{ tick, value, static_cast<std::uint32_t>( std::size(m_data) ) } );
+    }
+    else
+    {
+        int change{ value - m_value };
+
+        putNumber( static_cast<std::uint32_t>( tick - m_tick ) );
+        putNumber( (static_cast<std::uint32_t>(change) << 1) ^ static_cast<std::uint32_t>(change >> 31) );
+    }
+
+    m_tick = tick;
+    m_value = value;
+    ++m_count;
+}
+
+inline int ControlLane::valueAt(long tick, int fallback) const
+{
+    auto after{ std::upper_bound( m_checkpoints.begin(), m_checkpoints.end(), tick,
+                                  [](long t, const Checkpoint& c) { return t < c.tick; } ) };
+
+    if ( after == m_checkpoints.begin() )
+        return fallback;
+
+    const Checkpoint& checkpoint{ *(after - 1) };
+
+    std::size_t offset{ checkpoint.offset };
+    std::size_t end{ after != m_checkpoints.end() ? after->offset : std::size(m_data) };
+
+    long t{ checkpoint.tick };
+    int value{ checkpoint.value };
+
+    while ( offset < end )
+    {
+        long next_tick{ t + static_cast<long>( getNumber(m_data, offset) ) };
+        std::uint32_t zigzag{ getNumber(m_data, offset) };
+
+        if ( next_tick > tick )
+            break;
+
+        t = next_tick;
+        value += static_cast<int>( (zigzag >> 1) ^ (~(zigzag & 1) + 1) );
+    }
+
+    return value;
+}
+
+//name a lane for printing
+
+inline std::string laneName(int lane)
+{
+    switch (lane)
+    {
+    case 1: return "Modulation";
+    case 7: return "Volume";
+    case 10: return "Pan";
+    case 11: return "Expression";
+    case sustain_pedal: return "Sustain Pedal";
+    case program_lane: return "Program Change";
+    case pitch_bend_lane: return "Pitch Bend";
+    case pressure_lane: return "Channel Pressure";
+    default: break;
+    }
+
+    if ( lane >= poly_pressure_lane )
+        return "Key Pressure " + std::to_string( lane - poly_pressure_lane );
+
+    return "Controller " + std::to_string(lane);
+}
+
+class ControlLanes : public ControlListener
+{
+public:
+    //track, channel, lane
+    using Key = std::tuple<int, int, int>;
+
+    void trackStarted() override { ++m_track; }
+
+    void controlChange(long tick, int channel, int lane, int value) override
+    {
+        m_lanes[ Key{ m_track, channel, lane } ].add( tick, value );
+    }
+
+    //the lane for a track (counting from 0), channel and lane number, or nullptr if it has no events
+    const ControlLane* find(int track, int channel, int lane) const
+    {
+        auto found{ m_lanes.find( Key{ track, channel, lane } ) };
+
+        return ( found != m_lanes.end() ) ? &found->second : nullptr;
+    }
+
+    //give back the slack of every lane once the file is done
+    void shrink()
+    {
+        for ( auto& [key, lane] : m_lanes )
+            lane.shrink();
+    }
+
+    friend std::ostream& operator<< (std::ostream& out, const ControlLanes& c);
+
+private:
+    int m_track{ -1 };
+
+    std::map<Key, ControlLane> m_lanes{};
+};
+
+//print one line per lane: where it is, how many events it has, how much it takes to store, and its last value
+inline std::ostream& operator<< (std::ostream& out, const ControlLanes& c)
+{
+    for ( const auto& [key, lane] : c.m_lanes )
+    {
+        out << "Track " << std::get<0>(key) << ", channel " << std::get<1>(key) << ", "
+            << laneName( std::get<2>(key) ) << ": " << std::size(lane) << " events in "
+            << lane.memoryUsage() << " bytes, last value " << lane.lastValue() << '\n';
+    }
+
+    return out;
+}
@@ -0,0 +1,258 @@
+//)a DensityPyramid summarizes when and how densely the notes of a file sound, at every power-of-two zoom level,
+//// so an overview of any stretch of the file at any zoom only has to read the buckets it shows
+//)level 0 has the narrowest buckets (a sixteenth note rounded down to a power of two ticks); every level above it
+//// has buckets twice as wide, up to a single bucket for the whole file
+//)every bucket holds the number of notes that start in it, their pitch range and loudest velocity,
+//// and the most notes sounding at once at any tick of the bucket (all tracks together)
+//)the notes are seen once, as they are decoded: each one only touches the level 0 bucket it starts in,
+//// and keeps its first and last tick for finish(), which sweeps through them in order of tick for the polyphony
+//// and builds the levels above; if level 0 would grow past max_buckets, its buckets are merged in pairs
+//// and doubled in width, so the buckets stay bounded for any file (the ticks take 16 bytes a note until finish())
+
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "MIDInotes.h"
+
+struct DensityBucket
+{
+    //notes that start in the bucket
+    std::uint32_t notes{ 0 };
+
+    //most notes sounding at once, at any tick of the bucket
+    std::uint16_t polyphony{ 0 };
+
+    //pitch range and loudest velocity of the notes that start in the bucket (0 if there are none)
+    std::uint8_t low{ 0 };
+    std::uint8_t high{ 0 };
+    std::uint8_t velocity{ 0 };
+};
+
+class DensityPyramid : public NoteListener
+{
+public:
+    static constexpr std::size_t max_buckets{ 1 << 18 };
+
+    void setDivision(short quarter_note) override
+    {
+        //the widest power of two that fits in a sixteenth note
+        m_shift = 0;
+
+        while ( (2 << m_shift) <= quarter_note / 4 )
+            ++m_shift;
+    }
+
+    void noteFinished(const MIDInote& note) override;
+
+    //build the levels from the notes seen so far
+    void finish();
+
+    std::size_t levels() const { return std::size(m_levels); }
+
+    //width of a level's buckets in ticks
+    long bucketTicks(std::size_t level) const { return 1L << (m_shift + level); }
+
+    const std::vector<DensityBucket>& level(std::size_t level) const { return m_levels[level]; }
+
+    //the finest level whose buckets are at least ticks wide (or the coarsest level)
+    std::size_t levelFor(long ticks) const;
+
+    //the bucket of a level that holds tick
+    std::size_t bucketAt(std::size_t level, long tick) const { return static_cast<std::size_t>( tick >> (m_shift + level) ); }
+
+    friend std::ostream& operator<< (std::ostream& out, const DensityPyramid& d);
+
+private:
+    //what level 0 collects before finish(): a note counts where it starts
+    struct Counts
+    {
+        std::uint32_t starts{ 0 };
+
+        std::uint8_t low{ 0 };
+        std::uint8_t high{ 0 };
+        std::uint8_t velocity{ 0 };
+    };
+
+    //merge level 0's buckets in pairs
+    void widen();
+
+    int m_shift{ 0 };
+
+    std::vector<Counts> m_counts{};
+
+    //the tick every note starts on and the tick after the last one it sounds in, for the polyphony sweep
+    std::vector<long> m_onsets{};
+    std::vector<long> m_ends{};
+
+    std::vector<std::vector<DensityBucket>> m_levels{};
+};
+
+//define DensityPyramid member functions
+
+inline void DensityPyramid::noteFinished(const MIDInote& note)
+{
+    int pitch{ note.getPitch().MIDInote() };
+
+    if ( pitch < 0 || pitch > 127 )
+        return;
+
+    //the last tick the note sounds in (a note without a duration still counts in the bucket it starts in)
+    long last_tick{ note.onset() + std::max( note.duration() - 1, 0L ) };
+
+    while ( static_cast<std::size_t>( last_tick >> m_shift ) >= max_buckets )
+        widen();
+
+    std::size_t first{ static_cast<std::size_t>( note.onset() >> m_shift ) };
+    std::size_t last{ static_cast<std::size_t>( last_tick >> m_shift ) };
+
+    if ( last >= std::size(m_counts) )
+        m_counts.resize( last + 1 );
+
+    Counts& start{ m_counts[first] };
+    std::uint8_t p{ static_cast<std::uint8_t>(pitch) };
+
+    start.low = ( start.starts == 0 ) ? p : std::min( start.low, p );
+    start.high = ( start.starts == 0 ) ? p : std::max( start.high, p );
+    start.velocity = std::max( start.velocity, static_cast<std::uint8_t>( std::clamp(note.velocity(), 0, 127) ) );
+
+    ++start.starts;
+
+    m_onsets.push_back( note.onset() );
+    m_ends.push_back( last_tick + 1 );
+}
+
+inline void DensityPyramid::widen()
+{
+    std::vector<Counts> wider( (std::size(m_counts) + 1) / 2 );
+
+    for ( std::size_t b{ 0 }; b < std::size(m_counts); ++b )
+    {
+        const Counts& c{ m_counts[b] };
+        Counts& w{ wider[b / 2] };
+
+        if ( c.starts > 0 )
+        {
+            w.low = ( w.starts == 0 ) ? c.low : std::min( w.low, c.low );
+            w.high = ( w.starts == 0 ) ? c.high : std::max( w.high, c.high );
+            w.velocity = std::max( w.velocity, c.velocity );
+        }
+
+        w.starts += c.starts;
+    }
+
+    m_counts.swap( wider );
+    ++m_shift;
+}
+
+inline void DensityPyramid::finish()
+{
+    m_levels.assign( 1, std::vector<DensityBucket>( std::max( std::size(m_counts), std::size_t{ 1 } ) ) );
+
+    for ( std::size_t b{ 0 }; b < std::size(m_counts); ++b )
+    {
+        const Counts& c{ m_counts[b] };
+
+        m_levels[0][b] = DensityBucket{ c.starts, 0, c.low, c.high, c.velocity };
+    }
+
+    std::sort( m_onsets.begin(), m_onsets.end() );
+    std::sort( m_ends.begin(), m_ends.end() );
+
+    //sweep through the ticks where notes start or end; a note ending on a tick is off before one starting on it,
+    //so notes played one after another never count as sounding together
+    std::vector<DensityBucket>& level0{ m_levels[0] };
+    std::uint32_t sounding{ 0 };
+    std::size_t s{ 0 };
+    std::size_t e{ 0 };
+
+    while ( e < std::size(m_ends) )
+    {
+        long tick{ ( s < std::size(m_onsets) && m_onsets[s] < m_ends[e] ) ? m_onsets[s] : m_ends[e] };
+
+        for ( ; e < std::size(m_ends) && m_ends[e] == tick; ++e )
+            --sounding;
+
+        for ( ; s < std::size(m_onsets) && m_onsets[s] == tick; ++s )
+            ++sounding;
+
+        if ( sounding == 0 )
+            continue;
+
+        //the count holds until the next tick where a note starts or ends, through every bucket up to it
+        long next{ std::min( s < std::size(m_onsets) ? m_onsets[s] : LONG_MAX, m_ends[e] ) };
+        std::uint16_t polyphony{ static_cast<std::uint16_t>( std::min<std::uint32_t>( sounding, 0xFFFF ) ) };
+
+        std::size_t last{ std::min( bucketAt( 0, next - 1 ), std::size(level0) - 1 ) };
+
+        for ( std::size_t b{ bucketAt( 0, tick ) }; b <= last; ++b )
+            level0[b].polyphony = std::max( level0[b].polyphony, polyphony );
+    }
+
+    while ( std::size( m_levels.back() ) > 1 )
+    {
+        const std::vector<DensityBucket>& below{ m_levels.back() };
+        std::vector<DensityBucket> above( (std::size(below) + 1) / 2 );
+
+        for ( std::size_t b{ 0 }; b < std::size(below); ++b )
+        {
+            const DensityBucket& d{ below[b] };
+            DensityBucket& a{ above[b / 2] };
+
+            if ( d.notes > 0 )
+            {
+                a.low = ( a.notes == 0 ) ? d.low : std::min( a.low, d.low );
+                a.high = ( a.notes == 0 ) ? d.high : std::max( a.high, d.high );
+                a.velocity = std::max( a.velocity, d.velocity );
+            }
+
+            a.notes += d.notes;
+            a.polyphony = std::max( a.polyphony, d.polyphony );
+        }
+
+        m_levels.push_back( std::move(above) );
+    }
+
+    m_counts.clear();
+    m_counts.shrink_to_fit();
+
+    m_onsets.clear();
+    m_onsets.shrink_to_fit();
+    m_ends.clear();
+    m_ends.shrink_to_fit();
+}
+
+inline std::size_t DensityPyramid::levelFor(long ticks) const
+{
+    std::size_t level{ 0 };
+
+    while ( level + 1 < levels() && bucketTicks(level) < ticks )
+        ++level;
+
+    return level;
+}
+
+//print one line per level: its bucket width, how many buckets it has, and its busiest bucket
+inline std::ostream& operator<< (std::ostream& out, const DensityPyramid& d)
+{
+    for ( std::size_t l{ 0 }; l < d.levels(); ++l )
+    {
+        std::uint32_t notes{ 0 };
+        std::uint16_t polyphony{ 0 };
+
+        for ( const auto& b : d.level(l) )
+        {
+            notes = std::max( notes, b.notes );
+            polyphony = std::max( polyphony, b.polyphony );
+        }
+
+        out << "Level " << l << ": " << d.bucketTicks(l) << " ticks per bucket, " << std::size( d.level(l) )
+            << " buckets, up to " << notes << " notes starting and " << polyphony << " sounding\n";
+    }
+
+    return out;
+}
@@ -0,0 +1,230 @@
+//)a Fingerprint listens to every note as it is released by NoteVector and folds it into:
+//// a running hash over (pitch, channel, quantized onset, quantized duration), and
+//// a MinHash sketch over the same note tokens, for estimating similarity between files
+//)the running hash is a sum of per-note hashes, so it does not depend on the order in which
+//// notes arrive; two files with the same notes split across different tracks (or in a different
+//// track order) end up with the same fingerprint
+//)only notes go into the fingerprint: track names, tempo events and other meta events are ignored,
+//// and onsets/durations are measured in ticks, so tempo changes do not affect it either
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include "MIDInotes.h"
+
+//splitmix64 finalizer; scrambles a 64-bit value well enough for hashing note tokens
+inline std::uint64_t mixBits(std::uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+    return x ^ (x >> 31);
+}
+
+class Fingerprint : public NoteListener
+{
+public:
+    //number of hash functions in the MinHash sketch; similarity estimates are within ~1/sqrt(64) = 12.5%
+    static constexpr std::size_t sketch_size{ 64 };
+
+    //quantize onsets and durations to sixteenth notes, relative to the file's ticks per quarter note,
+    //so files saved with different divisions still match
+    explicit Fingerprint(short quarter_note=96)
+    {
+        setDivision( quarter_note );
+        m_sketch.fill( std::numeric_limits<std::uint64_t>::max() );
+    }
+
+    void setDivision(short quarter_note) override { m_grid = ( quarter_note >= 4 ? quarter_note / 4 : 1 ); }
+
+    void noteFinished(const MIDInote& note) override;
+
+    std::uint64_t hash() const { return m_hash; }
+
+    std::size_t count() const { return m_count; }
+
+    //estimated Jaccard similarity of the two files' note sets (0.0 - 1.0)
+    double similarity(const Fingerprint& other) const;
+
+    //the sketch is cut into bands of band_rows hashes for finding likely near-duplicates (see clusterFingerprints)
+    static constexpr std::size_t band_rows{ 4 };
+    static constexpr std::size_t bands{ sketch_size / band_rows };
+
+    //a hash of one band of the sketch; files with a band in common are candidates for near-duplicates
+    std::uint64_t band(std::size_t b) const;
+
+    friend std::ostream& operator<< (std::ostream& out, const Fingerprint& f);
+
+private:
+    long quantize(long ticks) const { return (ticks + m_grid / 2) / m_grid; }
+
+    long m_grid{};
+
+    std::uint64_t m_hash{ 0 };
+    std::size_t m_count{ 0 };
+
+    std::array<std::uint64_t, sketch_size> m_sketch{};
+};
+
+//define Fingerprint member functions
+
+inline void Fingerprint::noteFinished(const MIDInote& note)
+{
+    std::uint64_t token{ mixBits( static_cast<std::uint64_t>(note.getPitch().MIDInote()) << 4 | note.channel() ) };
+    token = mixBits( token ^ static_cast<std::uint64_t>( quantize(note.onset()) ) );
+    token = mixBits( token ^ static_cast<std::uint64_t>( quantize(note.duration()) ) );
+
+    //addition is commutative, so the hash is independent of track layout
+    m_hash += token;
+    ++m_count;
+
+    //each slot of the sketch is a different hash function (token mixed with its slot's seed);
+    //keep the minimum value seen by each
+    for ( std::size_t i{ 0 }; i < sketch_size; ++i )
+    {
+        std::uint64_t h{ mixBits( token ^ mixBits(i + 1) ) };
+
+        if ( h < m_sketch[i] )
+            m_sketch[i] = h;
+    }
+}
+
+inline double Fingerprint::similarity(const Fingerprint& other) const
+{
+    if ( m_count == 0 || other.m_count == 0 )
+        return ( m_count == other.m_count ) ? 1.0 : 0.0;
+
+    std::size_t matches{ 0 };
+
+    for ( std::size_t i{ 0 }; i < sketch_size; ++i )
+    {
+        if ( m_sketch[i] == other.m_sketch[i] )
+            ++matches;
+    }
+
+    return static_cast<double>(matches) / sketch_size;
+}
+
+inline std::uint64_t Fingerprint::band(std::size_t b) const
+{
+    std::uint64_t h{ mixBits(b) };
+
+    for ( std::size_t r{ b * band_rows }; r < (b + 1) * band_rows; ++r )
+        h = mixBits( h ^ m_sketch[r] );
+
+    return h;
+}
+
+//print in "hash (count notes)" format, followed by the sketch on the next line
+inline std::ostream& operator<< (std::ostream& out, const Fingerprint& f)
+{
+    auto flags{ out.flags() };
+    auto fill{ out.fill() };
+
+    out << std::hex << std::setfill('0') << std::setw(16) << f.m_hash;
+    out << std::dec << " (" << f.m_count << " notes)\n";
+
+    out << "Sketch:" << std::hex;
+
+    for ( auto h : f.m_sketch )
+    {
+        out << ' ' << std::setw(16) << h;
+    }
+
+    out.flags( flags );
+    out.fill( fill );
+
+    return out;
+}
+
+//group the fingerprints of a batch into clusters of duplicates:
+//identical hashes are exact duplicates, and sketches at or above the threshold are near-duplicates;
+//returns the indices of every cluster with more than one member (files without notes are never in one)
+//)exact duplicates are found through a map of hashes, and only one file of each is looked at after that;
+//// near-duplicates are only looked for among files with a band of the sketch in common (locality-sensitive hashing),
+//// so the batch isn't compared pair by pair; with 16 bands of 4, files at a similarity of 0.8 share a band
+//// all but 0.02% of the time, and at 0.5 a third of the time (so most dissimilar files are never compared)
+inline std::vector<std::vector<std::size_t>> clusterFingerprints(const std::vector<Fingerprint>& prints, double threshold)
+{
+    //union-find over the indices of the batch
+    std::vector<std::size_t> parent( std::size(prints) );
+    std::iota( parent.begin(), parent.end(), 0 );
+
+    auto find{ [&parent](std::size_t i)
+    {
+        while ( parent[i] != i )
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+
+        return i;
+    } };
+
+    //first file with every hash
+    std::unordered_map<std::uint64_t, std::size_t> exact{};
+
+    //files with every band (the band's number is mixed into its hash)
+    std::unordered_map<std::uint64_t, std::vector<std::size_t>> candidates{};
+
+    for ( std::size_t i{ 0 }; i < std::size(prints); ++i )
+    {
+        //a file without notes (a tempo map, a sysex dump, one whose notes couldn't be decoded) has an empty sketch,
+        //which matches every other empty one; it stays a cluster of its own
+        if ( prints[i].count() == 0 )
+            continue;
+
+        auto [first, added]{ exact.emplace( prints[i].hash(), i ) };
+
+        if ( !added )
+        {
+            parent[ find(i) ] = find( first->second );
+            continue;
+        }
+
+        for ( std::size_t b{ 0 }; b < Fingerprint::bands; ++b )
+        {
+            auto& others{ candidates[ prints[i].band(b) ] };
+
+            for ( std::size_t j : others )
+            {
+                if ( find(i) != find(j) && prints[i].similarity( prints[j] ) >= threshold )
+                    parent[ find(i) ] = find(j);
+            }
+
+            others.push_back( i );
+        }
+    }
+
+    std::vector<std::vector<std::size_t>> clusters{};
+    std::vector<std::size_t> slot( std::size(prints), std::size(prints) );
+
+    for ( std::size_t i{ 0 }; i < std::size(prints); ++i )
+    {
+        std::size_t root{ find(i) };
+
+        if ( slot[root] == std::size(prints) )
+        {
+            slot[root] = std::size(clusters);
+            clusters.emplace_back();
+        }
+
+        clusters[ slot[root] ].push_back( i );
+    }
+
+    clusters.erase( std::remove_if( clusters.begin(), clusters.end(),
+                                    [](const auto& c) { return std::size(c) < 2; } ),
+                    clusters.end() );
+
+    return clusters;
+}
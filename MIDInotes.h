@@ -12,11 +12,13 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <sstream>
 #include <iostream>
 #include <array>
 #include <string>
+#include <string_view>
 
 //create class to hold separate pitch octave info
 
@@ -32,6 +34,10 @@ public:
 
     int MIDInote() const { return m_midinote; }
 
+    int pitch() const { return m_pitch; }
+
+    int octave() const { return m_octave; }
+
     friend std::ostream& operator<< (std::ostream& out, const Pitch8ve& p8);
 
 private:
@@ -64,6 +70,31 @@ inline std::string_view toPitch(int pitch)
     }
 }
 
+//name the major key of a key signature from its number of sharps (negative for flats)
+
+inline std::string_view toKey(int sharps)
+{
+    switch (sharps)
+    {
+    case -7: return "Cb";
+    case -6: return "Gb";
+    case -5: return "Db";
+    case -4: return "Ab";
+    case -3: return "Eb";
+    case -2: return "Bb";
+    case -1: return "F";
+    case 0: return "C";
+    case 1: return "G";
+    case 2: return "D";
+    case 3: return "A";
+    case 4: return "E";
+    case 5: return "B";
+    case 6: return "F#";
+    case 7: return "C#";
+    default: return "???";
+    }
+}
+
 inline std::ostream& operator<< (std::ostream& out, const Pitch8ve& p8)
 {
     out << toPitch(p8.m_pitch) << p8.m_octave;
@@ -72,40 +103,85 @@ inline std::ostream& operator<< (std::ostream& out, const Pitch8ve& p8)
 }
 
 //create class to store MIDI note info;
-//default rhythm to 0 since every new MIDI note has no duration yet
+//every new MIDI note has no duration yet
 
 class MIDInote
 {
 public:
-    MIDInote(int channel, int pitch, int rhythm=0)
+    MIDInote(int channel, int pitch)
         : m_channel{ channel & 0x0f }
         , m_pitch{ pitch }
-        , m_rhythm{ rhythm }
     {
     }
 
-    void hold(int delta) { m_rhythm += delta; }
+    //the note has been held until tick; m_rhythm counts from the last time the note was tied over a meta event,
+    //so m_duration keeps the full length of the note in ticks
+    void holdUntil(long tick) { m_rhythm = static_cast<int>( tick - m_tied ); m_duration = tick - m_onset; }
+
+    //the note is tied over a meta event at tick, so its rhythm starts again from 0
+    void tie(long tick) { m_tied = tick; m_rhythm = 0; }
 
     void turnOff() { m_on = false; }
 
-    bool isOn() { return m_on; }
+    //the key has been released, but the sustain pedal is keeping the note on
+    void sustain() { m_sustained = true; }
+
+    bool isSustained() const { return m_sustained; }
+
+    bool isOn() const { return m_on; }
+
+    int channel() const { return m_channel; }
+
+    void setVelocity(int velocity) { m_velocity = velocity; }
 
-    int channel() { return m_channel; }
+    int velocity() const { return m_velocity; }
 
-    Pitch8ve getPitch() { return m_pitch; }
+    Pitch8ve getPitch() const { return m_pitch; }
 
-    void setRhythm(int r) { m_rhythm = r; }
+    void setOnset(long tick) { m_onset = tick; m_tied = tick; }
+
+    //absolute tick (from the start of the track) at which the note was turned on
+    long onset() const { return m_onset; }
+
+    long duration() const { return m_duration; }
 
     //return rhythm in relation to ticks per quarter note (derived from the header)
     double getRhythm(short quarter_note) { return static_cast<double>(m_rhythm) / quarter_note; }
 
 private:
     int m_channel{};
+    int m_velocity{};
 
     Pitch8ve m_pitch{};
     int m_rhythm{};
 
+    long m_onset{};
+    long m_duration{};
+
+    //tick the rhythm is counted from
+    long m_tied{};
+
     bool m_on{ true };
+    bool m_sustained{ false };
+};
+
+//create interface for anything that wants to see every note once it has been released
+//(fingerprints, statistics, etc.), so that it can be computed while the track is being decoded
+
+class NoteListener
+{
+public:
+    virtual ~NoteListener() = default;
+
+    //called once per file, before any notes, with the header's ticks per quarter note
+    virtual void setDivision(short /*quarter_note*/) {}
+
+    //called at the start of every track; onsets are relative to the start of their track
+    virtual void trackStarted() {}
+
+    virtual void noteStarted(const MIDInote& /*note*/) {}
+
+    virtual void noteFinished(const MIDInote& note) = 0;
 };
 
 //create class to hold all MIDI notes recorded in the track
@@ -113,16 +189,68 @@ private:
 class NoteVector
 {
 public:
-    void addNote(MIDInote m) { m_notes.push_back( m ); }
+    explicit NoteVector(std::ostream& out = std::cout)
+        : m_out{ &out }
+    {
+    }
+
+    void addNote(MIDInote m);
 
     void addDelta(int d);
 
     void noteOff(int status, int pitch);
 
+    //press or release a channel's sustain pedal; releasing it turns off every note it was holding
+    void pedal(int channel, bool down);
+
     void printNotes(short quarter_note);
 
+    //print the notes that can be printed without waiting for a meta event
+    //(every finished note up to the first one still on), so they can be evicted;
+    //with tie_held, the notes still on before the last finished note are printed tied, as they would be
+    //at a meta event, so a long-held note doesn't keep every note after it waiting;
+    //returns how many notes were printed tied
+    std::size_t emitFinished(short quarter_note, bool tie_held=false);
+
+    long tick() const { return m_tick; }
+
+    std::size_t memoryUsage() const
+    {
+        return m_notes.capacity() * sizeof(MIDInote) + m_sounding.capacity() * sizeof(std::size_t);
+    }
+
+    void addListener(NoteListener* listener) { m_listeners.push_back( listener ); }
+
+    //hand any notes that are still on at the end of the track to the listeners
+    void flush();
+
 private:
+    void printNote(MIDInote& n, short quarter_note);
+
+    //drop the notes that have been printed and turned off; they are never looked at again
+    void evict();
+
+    std::ostream* m_out{};
+
     std::vector<MIDInote> m_notes{};
+    std::vector<NoteListener*> m_listeners{};
+
+    //indices in m_notes of the notes that are still on, in order, so note offs don't have to look
+    //through every note since the last meta event (a one-track file may not have any)
+    std::vector<std::size_t> m_sounding{};
+
+    //whether "MIDI Notes:" has been printed for the notes since the last meta event
+    bool m_header{ false };
+
+    void release(MIDInote& n);
+
+    //forget the notes in m_sounding that have been turned off
+    void dropReleased();
+
+    std::array<bool, 16> m_pedals{};
+
+    //absolute tick of the track, used to timestamp new notes
+    long m_tick{ 0 };
 
     std::size_t m_index{ 0 };
     std::size_t m_endex{ 0 };
@@ -130,28 +258,105 @@ private:
 
 //define NoteVector member functions
 
-inline void NoteVector::addDelta(int d)
+inline void NoteVector::addNote(MIDInote m)
 {
-    for ( auto& n : m_notes )
+    //striking a note again ends the sustained one
+    if ( m_pedals[ m.channel() ] )
     {
-        //only increment m_rhythm if the note is still on
-        if ( n.isOn() )
+        for ( std::size_t i : m_sounding )
         {
-            n.hold(d);
+            MIDInote& n{ m_notes[i] };
+
+            if ( n.isSustained() && n.channel() == m.channel() && n.getPitch().MIDInote() == m.getPitch().MIDInote() )
+                release( n );
         }
+
+        dropReleased();
+    }
+
+    m.setOnset( m_tick );
+
+    m_sounding.push_back( std::size(m_notes) );
+    m_notes.push_back( m );
+
+    for ( auto* l : m_listeners )
+    {
+        l->noteStarted( m );
     }
 }
 
+//notes that are on are held until the current tick whenever they are printed or released,
+//so a delta doesn't have to touch every note
+inline void NoteVector::addDelta(int d)
+{
+    m_tick += d;
+}
+
 inline void NoteVector::noteOff(int status, int pitch)
 {
-    for ( auto& n : m_notes )
+    for ( std::size_t i : m_sounding )
+    {
+        MIDInote& n{ m_notes[i] };
+
+        if ( !n.isSustained() && n.channel() == (status & 0x0f) && n.getPitch().MIDInote() == pitch )
+        {
+            if ( m_pedals[ n.channel() ] )
+                n.sustain();
+            else
+                release( n );
+        }
+    }
+
+    dropReleased();
+}
+
+inline void NoteVector::pedal(int channel, bool down)
+{
+    m_pedals[ channel & 0x0f ] = down;
+
+    if ( down )
+        return;
+
+    for ( std::size_t i : m_sounding )
     {
-        if ( n.isOn() )
+        MIDInote& n{ m_notes[i] };
+
+        if ( n.isSustained() && n.channel() == (channel & 0x0f) )
+            release( n );
+    }
+
+    dropReleased();
+}
+
+inline void NoteVector::release(MIDInote& n)
+{
+    n.holdUntil( m_tick );
+    n.turnOff();
+
+    for ( auto* l : m_listeners )
+    {
+        l->noteFinished( n );
+    }
+}
+
+inline void NoteVector::dropReleased()
+{
+    m_sounding.erase( std::remove_if( m_sounding.begin(), m_sounding.end(),
+                                      [this](std::size_t i) { return !m_notes[i].isOn(); } ),
+                      m_sounding.end() );
+}
+
+inline void NoteVector::flush()
+{
+    for ( std::size_t i : m_sounding )
+    {
+        MIDInote& n{ m_notes[i] };
+
+        n.holdUntil( m_tick );
+
+        for ( auto* l : m_listeners )
         {
-            if ( n.channel() == (status & 0x0f) && n.getPitch().MIDInote() == pitch )
-            {
-                n.turnOff();
-            }
+            l->noteFinished( n );
         }
     }
 }
@@ -161,31 +366,104 @@ inline void NoteVector::noteOff(int status, int pitch)
 //for example, only implement NoteVector::addDelta() if the delta time byte > 0, in which case ++endex
 inline void NoteVector::printNotes(short quarter_note)
 {
-    if (m_index != std::size(m_notes) )
-        std::cout << "MIDI Notes:\n";
+    if ( m_index != std::size(m_notes) && !m_header )
+        *m_out << "MIDI Notes:\n";
 
     while( m_index < std::size(m_notes) )
     {
-        std::cout << m_notes[m_index].getPitch() << ' ';
+        printNote( m_notes[m_index], quarter_note );
 
-        //if this note is still on, it is being held over a meta event,
-        //which could be, for instance, a time signature or tempo change
-        if ( m_notes[m_index].isOn() )
-        {
-            std::cout << '(' << m_notes[m_index].getRhythm( quarter_note ) << ")\n";
+        ++m_index;
+    }
+
+    m_header = false;
+
+    evict();
+}
+
+inline std::size_t NoteVector::emitFinished(short quarter_note, bool tie_held)
+{
+    std::size_t tied{ 0 };
 
-            //in the eventual score, this note will be tied over
+    //print up to the first note still on, or with tie_held, up to the last note that isn't
+    std::size_t last{ m_index };
 
-            //set rhythm back to 0 to specify later for how many more quarter notes to hold the note after the meta event
-            m_notes[m_index].setRhythm( 0 );
+    if ( tie_held )
+    {
+        for ( std::size_t i{ m_index }; i < std::size(m_notes); ++i )
+        {
+            if ( !m_notes[i].isOn() )
+                last = i + 1;
         }
-        else
+    }
+
+    while( m_index < std::size(m_notes) && ( m_index < last || !m_notes[m_index].isOn() ) )
+    {
+        if ( !m_header )
         {
-            std::cout << m_notes[m_index].getRhythm( quarter_note ) << '\n';
+            *m_out << "MIDI Notes:\n";
+            m_header = true;
         }
 
+        if ( m_notes[m_index].isOn() )
+            ++tied;
+
+        printNote( m_notes[m_index], quarter_note );
+
         ++m_index;
-    } 
+    }
+
+    evict();
+
+    return tied;
+}
+
+inline void NoteVector::printNote(MIDInote& n, short quarter_note)
+{
+    *m_out << n.getPitch() << ' ';
+
+    //if this note is still on, it is being held over a meta event,
+    //which could be, for instance, a time signature or tempo change
+    if ( n.isOn() )
+    {
+        n.holdUntil( m_tick );
+
+        *m_out << '(' << n.getRhythm( quarter_note ) << ")\n";
+
+        //in the eventual score, this note will be tied over
+
+        //set rhythm back to 0 to specify later for how many more quarter notes to hold the note after the meta event
+        n.tie( m_tick );
+    }
+    else
+    {
+        *m_out << n.getRhythm( quarter_note ) << '\n';
+    }
+}
+
+inline void NoteVector::evict()
+{
+    //notes that are still on keep their order at the front, followed by the unprinted notes
+    auto printed{ m_notes.begin() + m_index };
+    auto kept{ std::remove_if( m_notes.begin(), printed, [](const MIDInote& n) { return !n.isOn(); } ) };
+
+    std::size_t printed_index{ m_index };
+    std::size_t removed{ static_cast<std::size_t>( printed - kept ) };
+
+    m_index = static_cast<std::size_t>( kept - m_notes.begin() );
+    m_notes.erase( kept, printed );
+
+    //the printed notes that are still on are now the first ones, and the rest moved down past the removed ones
+    std::size_t front{ 0 };
+
+    for ( auto& i : m_sounding )
+    {
+        i = ( i < printed_index ) ? front++ : i - removed;
+    }
+
+    //give memory back after a burst of notes instead of holding on to the high-water mark
+    if ( m_notes.capacity() > 64 && m_notes.capacity() > 4 * std::size(m_notes) )
+        m_notes.shrink_to_fit();
 }
 
 //will eventually need to reconcile a method of writing moving notes over held ones
\ No newline at end of file
@@ -0,0 +1,182 @@
+//declarations shared by main.cpp, header.cpp and tracks.cpp
+
+#pragma once
+
+#include <array>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include "MIDInotes.h"
+
+//create class to keep track of how much memory a bounded-memory parse is using;
+//it counts what the parser itself holds (the track's input and its notes), not what the listeners keep
+//(meta tables, piano rolls, controller lanes, etc. grow with the file however it is parsed)
+
+class MemoryMeter
+{
+public:
+    explicit MemoryMeter(std::size_t limit)
+        : m_limit{ limit }
+    {
+    }
+
+    //record the current usage; returns false if it is over the limit
+    bool record(std::size_t bytes)
+    {
+        if ( bytes > m_peak )
+            m_peak = bytes;
+
+        return ( bytes <= m_limit );
+    }
+
+    std::size_t limit() const { return m_limit; }
+
+    std::size_t peak() const { return m_peak; }
+
+private:
+    std::size_t m_limit{};
+    std::size_t m_peak{ 0 };
+};
+
+//create struct to hold a meta event as one row: the parser fills one in for every meta event it reads,
+//prints the note listing's line from it, and hands it to MetaListener::metaEvent (a MetaTable keeps them)
+
+struct MetaEvent
+{
+    //set by the MetaTable that keeps the row (counting from 0); the parser doesn't know it
+    int track{};
+    long tick{};
+
+    //the byte after FF
+    int type{};
+
+    //text events (01-07) and sequencer-specific events (7F), up to their first NUL; as handed over by the parser,
+    //a view of the track's bytes that is only good for the call (see MetaListener::textEvent)
+    std::string_view text{};
+
+    //set tempo: bpm; time signature: numerator and denominator; key signature: sharps (negative for flats) and minor;
+    //sequence number: the number; MIDI channel: the channel
+    double bpm{ 0.0 };
+    int first{ 0 };
+    int second{ 0 };
+
+    //the data bytes of a fixed-length event, as they are in the file (at most 5, for an SMPTE offset)
+    std::array<signed char, 5> data{};
+};
+
+//create interface for anything that wants the values of tempo, time signature, key signature and text events
+//as they are parsed (the meta-event counterpart of NoteListener)
+
+class MetaListener
+{
+public:
+    virtual ~MetaListener() = default;
+
+    //every meta event as a row; unless it is overridden, the events that have a callback of their own below
+    //are handed to it, so a listener that overrides this one gets every event (sequence numbers, channel prefixes,
+    //SMPTE offsets, ends of tracks and unknown types too) instead of the other callbacks
+    virtual void metaEvent(const MetaEvent& e);
+
+    virtual void tempoChange(long /*tick*/, double /*bpm*/) {}
+
+    virtual void timeSignature(long /*tick*/, int /*numerator*/, int /*denominator*/) {}
+
+    virtual void keySignature(long /*tick*/, int /*sharps*/, bool /*minor*/) {}
+
+    //text, copyright, names, lyrics, markers, cue points and sequencer-specific events;
+    //type is the byte after FF, and text (up to its first NUL, if any) is a view of the track's bytes
+    //that is only good for the call, so keep a copy (or intern it in a StringPool) to hold on to it
+    virtual void textEvent(long /*tick*/, int /*type*/, std::string_view /*text*/) {}
+};
+
+inline void MetaListener::metaEvent(const MetaEvent& e)
+{
+    switch (e.type)
+    {
+    case 0x51:
+        tempoChange( e.tick, e.bpm );
+        break;
+    case 0x58:
+        timeSignature( e.tick, e.first, e.second );
+        break;
+    case 0x59:
+        keySignature( e.tick, e.first, e.second != 0 );
+        break;
+    case 0x01: case 0x02: case 0x03: case 0x04: case 0x05: case 0x06: case 0x07: case 0x7F:
+        textEvent( e.tick, e.type, e.text );
+        break;
+    default:
+        break;
+    }
+}
+
+//lanes of controller-type events: controller numbers 0-127 are their own lanes, followed by these;
+//polyphonic key pressure has a lane per note, from poly_pressure_lane + 0 to poly_pressure_lane + 127
+constexpr int program_lane{ 128 };
+constexpr int pitch_bend_lane{ 129 };
+constexpr int pressure_lane{ 130 };
+constexpr int poly_pressure_lane{ 256 };
+
+//controller number of the sustain (damper) pedal
+constexpr int sustain_pedal{ 64 };
+
+//create interface for anything that wants controller changes, program changes,
+//channel and key pressure, and pitch bend (centred on 0, from -8192 to 8191)
+
+class ControlListener
+{
+public:
+    virtual ~ControlListener() = default;
+
+    //called at the start of every track; ticks are relative to the start of their track
+    virtual void trackStarted() {}
+
+    virtual void controlChange(long tick, int channel, int lane, int value) = 0;
+};
+
+//bytes of track input read at a time in bounded-memory mode
+constexpr std::size_t input_window{ 4096 };
+
+//smallest part of a track worth decoding on a thread of its own
+constexpr std::size_t min_segment{ 64 * 1024 };
+
+//create struct to hold everything that changes how a file is parsed,
+//so new options don't have to be threaded through every parse function separately
+
+struct ParseOptions
+{
+    //every NoteVector created while parsing will hand its released notes to these
+    std::vector<NoteListener*> listeners{};
+
+    std::vector<MetaListener*> meta_listeners{};
+
+    std::vector<ControlListener*> control_listeners{};
+
+    //hold notes released while their channel's sustain pedal is down until the pedal comes up
+    //(or the same note is struck again), so durations are the sounding length
+    bool sustain{ false };
+
+    //where the notes and events of the file are printed; point at a stream without a buffer to print nothing
+    std::ostream* out{ &std::cout };
+
+    //where the parser complains about what it can't decode (unknown meta events, going over the memory limit)
+    std::ostream* err{ &std::cerr };
+
+    //if more than 1, a large track (a format 0 file's only one, say) is cut into up to this many segments of at least
+    //min_segment bytes, whose notes, controller-type events and meta events are decoded in parallel from guessed
+    //event starts, then handed to the listeners in order; the listeners see the same as when the track is decoded
+    //in one go (only used when nothing is printed, the sustain pedal isn't followed and memory isn't bounded)
+    std::size_t segments{ 1 };
+
+    //if set, tracks are read in windows of input_window bytes, finished notes are evicted as soon as
+    //they can be printed (a note held past the notes after it is printed tied if they don't fit otherwise,
+    //and a warning at the end of the track says how many were), and parsing stops if a track's input and the notes
+    //still on don't fit under the limit
+    MemoryMeter* memory{ nullptr };
+};
+
+short parseMIDIHeader(std::istream& inf, std::ostream& out, std::ostream& err = std::cerr);
+
+//returns false if parsing stopped early because a track went over the memory limit
+bool parseTracks(std::istream& inf, short quarter_note, const ParseOptions& options);
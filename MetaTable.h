@@ -0,0 +1,281 @@
+//)a StringPool keeps one copy of every distinct string given to intern(), in blocks that never move,
+//// so the views it hands out stay good for as long as the pool does; one pool can be shared by every file
+//// of a batch, so the instrument names, copyright notices and markers that repeat from file to file are kept once
+//)a MetaTable listens to the parser and keeps every meta event of a file as a row (see MetaEvent in MIDIparser.h),
+//// with its text interned in a StringPool, so they can be looked up (or printed) after the file has been decoded;
+//// the note listing prints its meta events from the same rows, with listMetaEvent()
+//)finish() indexes the rows of every type in order of tick (all tracks together), so find() picks out
+//// the rows of a type in a range of ticks with two binary searches
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "MIDInotes.h"
+#include "MIDIparser.h"
+
+class StringPool
+{
+public:
+    //strings are copied into blocks of this many bytes; a longer string gets a block of its own
+    static constexpr std::size_t block{ 64 * 1024 };
+
+    StringPool() = default;
+
+    //the views handed out point into the pool, so it can't be copied
+    StringPool(const StringPool&) = delete;
+    StringPool& operator= (const StringPool&) = delete;
+
+    //the pool's copy of s, made the first time s is seen
+    std::string_view intern(std::string_view s);
+
+    //number of distinct strings, and the bytes they take
+    std::size_t size() const { return std::size(m_strings); }
+
+    std::size_t bytes() const { return m_bytes; }
+
+private:
+    std::vector<std::unique_ptr<char[]>> m_blocks{};
+
+    //bytes left at the end of the last block
+    char* m_free{ nullptr };
+    std::size_t m_left{ 0 };
+
+    std::size_t m_bytes{ 0 };
+
+    std::unordered_set<std::string_view> m_strings{};
+};
+
+//define StringPool member functions
+
+inline std::string_view StringPool::intern(std::string_view s)
+{
+    //every empty string is the same one, and it has somewhere to point
+    if ( std::empty(s) )
+        return std::string_view{ "" };
+
+    auto found{ m_strings.find(s) };
+
+    if ( found != m_strings.end() )
+        return *found;
+
+    char* copy{};
+
+    if ( std::size(s) > m_left )
+    {
+        if ( std::size(s) > block / 4 )
+        {
+            copy = m_blocks.emplace_back( new char[ std::max( std::size(s), std::size_t{ 1 } ) ] ).get();
+        }
+        else
+        {
+            m_free = m_blocks.emplace_back( new char[block] ).get();
+            m_left = block;
+        }
+    }
+
+    if ( !copy )
+    {
+        copy = m_free;
+        m_free += std::size(s);
+        m_left -= std::size(s);
+    }
+
+    std::copy( s.begin(), s.end(), copy );
+    m_bytes += std::size(s);
+
+    return *m_strings.emplace( copy, std::size(s) ).first;
+}
+
+//name a meta event type for printing
+inline std::string_view metaName(int type)
+{
+    switch (type)
+    {
+    case 0x00: return "Sequence Number";
+    case 0x01: return "Text";
+    case 0x02: return "Copyright Notice";
+    case 0x03: return "Sequence/Track Name";
+    case 0x04: return "Instrument";
+    case 0x05: return "Lyrics";
+    case 0x06: return "Marker";
+    case 0x07: return "Cue Point";
+    case 0x20: return "MIDI Channel";
+    case 0x2F: return "End of Track";
+    case 0x51: return "Set Tempo";
+    case 0x54: return "SMPTE Offset";
+    case 0x58: return "Time Signature";
+    case 0x59: return "Key Signature";
+    case 0x7F: return "Sequencer Specific Event";
+    default: return "Unidentified MIDI Event";
+    }
+}
+
+//the listener is a NoteListener too, but only to be told where tracks start
+class MetaTable : public NoteListener, public MetaListener
+{
+public:
+    explicit MetaTable(StringPool& pool)
+        : m_pool{ pool }
+    {
+    }
+
+    void trackStarted() override { ++m_track; }
+
+    void noteFinished(const MIDInote&) override {}
+
+    //the text is interned rather than kept as a view: the parser lets go of a track's bytes as it reads them
+    void metaEvent(const MetaEvent& e) override
+    {
+        MetaEvent& row{ m_events.emplace_back(e) };
+
+        row.track = m_track;
+        row.text = m_pool.intern( e.text );
+    }
+
+    //index the rows by type once the file has been decoded
+    void finish();
+
+    //every row, in the order the parser saw them (track by track)
+    const std::vector<MetaEvent>& events() const { return m_events; }
+
+    std::size_t size() const { return std::size(m_events); }
+
+    //the rows of a type from first_tick to last_tick (inclusive), in order of tick
+    std::vector<const MetaEvent*> find(int type, long first_tick, long last_tick) const;
+
+    friend std::ostream& operator<< (std::ostream& out, const MetaTable& m);
+
+private:
+    StringPool& m_pool;
+
+    int m_track{ -1 };
+
+    std::vector<MetaEvent> m_events{};
+
+    //rows of every type, in order of tick
+    std::map<int, std::vector<std::size_t>> m_by_type{};
+};
+
+//define MetaTable member functions
+
+inline void MetaTable::finish()
+{
+    m_by_type.clear();
+
+    for ( std::size_t e{ 0 }; e < size(); ++e )
+        m_by_type[ m_events[e].type ].push_back(e);
+
+    //each track's rows are in order already, so a stable sort keeps tracks in order at the same tick
+    for ( auto& [type, rows] : m_by_type )
+    {
+        std::stable_sort( rows.begin(), rows.end(),
+                          [this](std::size_t a, std::size_t b) { return m_events[a].tick < m_events[b].tick; } );
+    }
+}
+
+inline std::vector<const MetaEvent*> MetaTable::find(int type, long first_tick, long last_tick) const
+{
+    std::vector<const MetaEvent*> found{};
+
+    auto rows{ m_by_type.find(type) };
+
+    if ( rows == m_by_type.end() )
+        return found;
+
+    auto first{ std::lower_bound( rows->second.begin(), rows->second.end(), first_tick,
+                                  [this](std::size_t e, long t) { return m_events[e].tick < t; } ) };
+    auto last{ std::upper_bound( first, rows->second.end(), last_tick,
+                                 [this](long t, std::size_t e) { return t < m_events[e].tick; } ) };
+
+    for ( auto e{ first }; e < last; ++e )
+        found.push_back( &m_events[*e] );
+
+    return found;
+}
+
+//print a row on one line (without the newline)
+inline std::ostream& operator<< (std::ostream& out, const MetaEvent& e)
+{
+    out << "Track " << e.track << ", tick " << e.tick << ", " << metaName(e.type) << ": ";
+
+    switch (e.type)
+    {
+    case 0x00:
+    case 0x20:
+        out << e.first;
+        break;
+    case 0x51:
+        out << e.bpm << " BPM";
+        break;
+    case 0x54:
+        out << int{ e.data[0] } << ':' << int{ e.data[1] } << ':' << int{ e.data[2] } << ':' << int{ e.data[3] }
+            << '.' << int{ e.data[4] };
+        break;
+    case 0x58:
+        out << e.first << '/' << e.second;
+        break;
+    case 0x59:
+        out << std::abs(e.first) << ( e.first < 0 ? " flats, " : " sharps, " ) << ( e.second ? "minor" : "major" );
+        break;
+    default:
+        out << e.text;
+        break;
+    }
+
+    return out;
+}
+
+//print a row as the note listing does, between the groups of notes (so a table's rows, in order,
+//are the listing without its notes)
+inline void listMetaEvent(std::ostream& out, const MetaEvent& e)
+{
+    out << metaName(e.type) << ": ";
+
+    switch (e.type)
+    {
+    case 0x00:
+    case 0x20:
+        out << e.first << '\n';
+        break;
+    case 0x2F:
+        out << "---\n\n";
+        break;
+    case 0x51:
+        out << e.bpm << " BPM\n";
+        break;
+    case 0x54:
+        out << int{ e.data[0] } << ':' << int{ e.data[1] } << ':' << int{ e.data[2] } << ':' << int{ e.data[3] }
+            << ':' << int{ e.data[4] } << '\n';
+        break;
+    case 0x58:
+        out << e.first << '/' << e.second;
+        out << "\n\t" << "MIDI clocks per quarter note: " << int{ e.data[2] };
+        out << "\n\t" << "Number of 32nd notes per 24 MIDI clocks: " << int{ e.data[3] } << '\n';
+        break;
+    case 0x59:
+        out << toKey(e.first) << ' ' << ( e.second ? "minor" : "Major" ) << '\n';
+        break;
+    default:
+        out << e.text << '\n';
+        break;
+    }
+}
+
+//print one line per row, track by track
+inline std::ostream& operator<< (std::ostream& out, const MetaTable& m)
+{
+    for ( const auto& e : m.m_events )
+        out << e << '\n';
+
+    return out;
+}
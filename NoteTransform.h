@@ -0,0 +1,330 @@
+//)NoteColumns keeps the notes of a decoded file in columns (onset, duration, pitch, velocity, channel),
+//// so a file can be decoded once and then transformed into any number of variants
+//)a NoteTransform is a chain of steps: time stretch, quantize to a grid of the file's quarter note, transpose,
+//// velocity scale and channel remap; apply() runs the whole chain over the notes a block at a time,
+//// so each column is read and written once while every step's loop works on a block that is still in cache
+//)pitches, velocities and channels are kept a byte each, so a block of them is small and 16 of them fit in a register:
+//// transpose works on 16 pitches at a time with SSE2's saturating byte arithmetic (part of every x86-64 target,
+//// so it needs no compiler flags; elsewhere it is a plain loop), and velocity scale and channel remap are a lookup
+//// per note in a table of every byte value, worked out once per transform (exactly as the arithmetic would come out)
+//)onsets and durations stay 64-bit, since a long (or malformed) file's ticks can pass 2^31;
+//// stretch and quantize are plain loops over them, as SSE2 can't convert between 64-bit integers and doubles
+//)replay() hands the (transformed) notes, and the tempo changes, to the listeners as if the file were being decoded,
+//// so fingerprints, piano rolls, density pyramids etc. can be made from every variant, and print() lists them
+//// the way the parser lists a file's notes
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "MIDInotes.h"
+#include "MIDIparser.h"
+
+struct NoteTransform
+{
+    //largest factors a transform takes: the tick of any real file times max_stretch still fits in a 64-bit long,
+    //and any velocity times max_velocity_scale is already past 127
+    static constexpr double max_stretch{ 1000.0 };
+    static constexpr double max_velocity_scale{ 127.0 };
+
+    //ticks are multiplied by stretch, then onsets and ends are moved to the nearest line of a grid
+    //of quantize lines per quarter note (4 for sixteenths; 0 leaves them alone)
+    double stretch{ 1.0 };
+    int quantize{ 0 };
+
+    //semitones; pitches are kept within what Pitch8ve can hold as a MIDI note (0-127)
+    int transpose{ 0 };
+
+    //velocities are kept between 1 and 127, so no note turns into a note off
+    double velocity_scale{ 1.0 };
+
+    //channels[c] is the channel that notes on channel c are moved to
+    std::array<int, 16> channels{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+};
+
+//the steps of a transform, each over a block of n notes
+
+inline void stretchTicks(long* ticks, std::size_t n, double factor)
+{
+    for ( std::size_t i{ 0 }; i < n; ++i )
+        ticks[i] = static_cast<long>( ticks[i] * factor + 0.5 );
+}
+
+//move onsets and ends to the nearest grid line; a note is never shorter than one grid line
+inline void quantizeTicks(long* onsets, long* durations, std::size_t n, long grid)
+{
+    for ( std::size_t i{ 0 }; i < n; ++i )
+    {
+        long onset{ (onsets[i] + grid / 2) / grid * grid };
+        long end{ (onsets[i] + durations[i] + grid / 2) / grid * grid };
+
+        onsets[i] = onset;
+        durations[i] = std::max( end - onset, grid );
+    }
+}
+
+inline void transposePitches(std::uint8_t* pitches, std::size_t n, int semitones)
+{
+    //pitches are 0-127, so moving them further than 127 either way is the same as 127
+    semitones = std::min( std::max( semitones, -127 ), 127 );
+
+    std::size_t i{ 0 };
+
+#if defined(__SSE2__)
+    //one of up and down is 0; saturating at 0 clamps the bottom, and pitches can't go past 127 + 127 = 254 at the top
+    __m128i up{ _mm_set1_epi8( static_cast<char>( std::max( semitones, 0 ) ) ) };
+    __m128i down{ _mm_set1_epi8( static_cast<char>( std::max( -semitones, 0 ) ) ) };
+    __m128i top{ _mm_set1_epi8( 127 ) };
+
+    for ( ; i + 16 <= n; i += 16 )
+    {
+        __m128i p{ _mm_loadu_si128( reinterpret_cast<const __m128i*>( pitches + i ) ) };
+
+        p = _mm_min_epu8( _mm_subs_epu8( _mm_adds_epu8( p, up ), down ), top );
+
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( pitches + i ), p );
+    }
+#endif
+
+    for ( ; i < n; ++i )
+        pitches[i] = static_cast<std::uint8_t>( std::min( std::max( pitches[i] + semitones, 0 ), 127 ) );
+}
+
+//a byte column's new value for every old one
+using ByteTable = std::array<std::uint8_t, 256>;
+
+//velocities are kept between 1 and 127, so no note turns into a note off
+inline ByteTable velocityTable(double factor)
+{
+    ByteTable table{};
+
+    for ( int v{ 0 }; v < 256; ++v )
+        table[v] = static_cast<std::uint8_t>( std::min( std::max( static_cast<int>( v * factor + 0.5 ), 1 ), 127 ) );
+
+    return table;
+}
+
+inline ByteTable channelTable(const std::array<int, 16>& map)
+{
+    ByteTable table{};
+
+    for ( int c{ 0 }; c < 256; ++c )
+        table[c] = static_cast<std::uint8_t>( map[ c & 0x0F ] & 0x0F );
+
+    return table;
+}
+
+inline void lookUpBytes(std::uint8_t* values, std::size_t n, const ByteTable& table)
+{
+    for ( std::size_t i{ 0 }; i < n; ++i )
+        values[i] = table[ values[i] ];
+}
+
+class NoteColumns : public NoteListener, public MetaListener
+{
+public:
+    //notes per block of apply(): a block of every column fits in the L1 cache
+    static constexpr std::size_t block{ 1024 };
+
+    void setDivision(short quarter_note) override
+    {
+        m_quarter_note = ( quarter_note > 0 ? quarter_note : 1 );
+    }
+
+    void trackStarted() override { m_tracks.push_back( size() ); }
+
+    void noteFinished(const MIDInote& note) override
+    {
+        m_onsets.push_back( note.onset() );
+        m_durations.push_back( note.duration() );
+        //out-of-range pitches and velocities only come from malformed files
+        m_pitches.push_back( static_cast<std::uint8_t>( std::min( std::max( note.getPitch().MIDInote(), 0 ), 127 ) ) );
+        m_velocities.push_back( static_cast<std::uint8_t>( std::min( std::max( note.velocity(), 0 ), 127 ) ) );
+        m_channels.push_back( static_cast<std::uint8_t>( note.channel() ) );
+    }
+
+    //tempo changes are kept so that stretched variants keep their timing in seconds
+    void tempoChange(long tick, double bpm) override
+    {
+        m_tempo_ticks.push_back( tick );
+        m_tempos.push_back( bpm );
+    }
+
+    std::size_t size() const { return std::size(m_onsets); }
+
+    short quarterNote() const { return m_quarter_note; }
+
+    //run every step of the transform over the notes, in one pass
+    void apply(const NoteTransform& transform);
+
+    //hand the notes to the listeners as the parser would: setDivision(), the tempo changes, then per track
+    //trackStarted() and every note's noteStarted() and noteFinished() in the order of the ticks they happen at
+    void replay(const std::vector<NoteListener*>& listeners, const std::vector<MetaListener*>& meta_listeners) const;
+
+    //print the notes as the parser lists them: per track, "MIDI Notes:" and then every note in order of onset,
+    //with its length in quarter notes (there are no meta events in between, so no note is printed tied)
+    void print(std::ostream& out) const;
+
+private:
+    short m_quarter_note{ 1 };
+
+    std::vector<long> m_onsets{};
+    std::vector<long> m_durations{};
+    std::vector<std::uint8_t> m_pitches{};
+    std::vector<std::uint8_t> m_velocities{};
+    std::vector<std::uint8_t> m_channels{};
+
+    //index of the first note of every track
+    std::vector<std::size_t> m_tracks{};
+
+    std::vector<long> m_tempo_ticks{};
+    std::vector<double> m_tempos{};
+};
+
+//define NoteColumns member functions
+
+inline void NoteColumns::apply(const NoteTransform& t)
+{
+    long grid{ t.quantize > 0 ? std::max( static_cast<long>( m_quarter_note / t.quantize ), 1L ) : 0 };
+
+    bool identity_channels{ true };
+
+    for ( int c{ 0 }; c < 16; ++c )
+        identity_channels = identity_channels && ( (t.channels[c] & 0x0F) == c );
+
+    ByteTable velocities{ velocityTable( t.velocity_scale ) };
+    ByteTable channels{ channelTable( t.channels ) };
+
+    if ( t.stretch != 1.0 )
+        stretchTicks( m_tempo_ticks.data(), std::size(m_tempo_ticks), t.stretch );
+
+    for ( std::size_t first{ 0 }; first < size(); first += block )
+    {
+        std::size_t n{ std::min( block, size() - first ) };
+
+        if ( t.stretch != 1.0 )
+        {
+            stretchTicks( m_onsets.data() + first, n, t.stretch );
+            stretchTicks( m_durations.data() + first, n, t.stretch );
+        }
+
+        if ( grid > 0 )
+            quantizeTicks( m_onsets.data() + first, m_durations.data() + first, n, grid );
+
+        if ( t.transpose != 0 )
+            transposePitches( m_pitches.data() + first, n, t.transpose );
+
+        if ( t.velocity_scale != 1.0 )
+            lookUpBytes( m_velocities.data() + first, n, velocities );
+
+        if ( !identity_channels )
+            lookUpBytes( m_channels.data() + first, n, channels );
+    }
+}
+
+inline void NoteColumns::replay(const std::vector<NoteListener*>& listeners, const std::vector<MetaListener*>& meta_listeners) const
+{
+    for ( auto* l : listeners )
+        l->setDivision( m_quarter_note );
+
+    for ( std::size_t t{ 0 }; t < std::size(m_tempos); ++t )
+    {
+        for ( auto* l : meta_listeners )
+            l->tempoChange( m_tempo_ticks[t], m_tempos[t] );
+    }
+
+    //starts in order of onset, finishes in order of end; at the same tick, notes finish before others start,
+    //but a note without a duration starts before it finishes
+    using Event = std::tuple<long, bool, std::size_t>;
+
+    std::vector<Event> starts{};
+    std::vector<Event> finishes{};
+
+    for ( std::size_t t{ 0 }; t < std::size(m_tracks); ++t )
+    {
+        std::size_t first{ m_tracks[t] };
+        std::size_t last{ t + 1 < std::size(m_tracks) ? m_tracks[t + 1] : size() };
+
+        starts.clear();
+        finishes.clear();
+
+        for ( std::size_t i{ first }; i < last; ++i )
+        {
+            starts.emplace_back( m_onsets[i], false, i );
+            finishes.emplace_back( m_onsets[i] + m_durations[i], m_durations[i] == 0, i );
+        }
+
+        std::sort( starts.begin(), starts.end() );
+
+        //notes are collected as they finish, so unless they were transformed out of order, they already are
+        if ( !std::is_sorted( finishes.begin(), finishes.end() ) )
+            std::sort( finishes.begin(), finishes.end() );
+
+        for ( auto* l : listeners )
+            l->trackStarted();
+
+        auto start{ starts.begin() };
+        auto finish{ finishes.begin() };
+
+        while ( finish != finishes.end() )
+        {
+            bool starting{ start != starts.end()
+                           && ( std::get<0>(*start) < std::get<0>(*finish)
+                                || ( std::get<0>(*start) == std::get<0>(*finish) && std::get<1>(*finish) ) ) };
+
+            std::size_t i{ std::get<2>( starting ? *start++ : *finish++ ) };
+
+            MIDInote note{ m_channels[i], m_pitches[i] };
+            note.setVelocity( m_velocities[i] );
+            note.setOnset( m_onsets[i] );
+
+            if ( starting )
+            {
+                for ( auto* l : listeners )
+                    l->noteStarted( note );
+            }
+            else
+            {
+                note.holdUntil( m_onsets[i] + m_durations[i] );
+                note.turnOff();
+
+                for ( auto* l : listeners )
+                    l->noteFinished( note );
+            }
+        }
+    }
+}
+
+inline void NoteColumns::print(std::ostream& out) const
+{
+    std::vector<std::size_t> order{};
+
+    for ( std::size_t t{ 0 }; t < std::size(m_tracks); ++t )
+    {
+        std::size_t first{ m_tracks[t] };
+        std::size_t last{ t + 1 < std::size(m_tracks) ? m_tracks[t + 1] : size() };
+
+        if ( first == last )
+            continue;
+
+        order.resize( last - first );
+        std::iota( order.begin(), order.end(), first );
+        std::stable_sort( order.begin(), order.end(), [this](std::size_t a, std::size_t b) { return m_onsets[a] < m_onsets[b]; } );
+
+        out << "MIDI Notes:\n";
+
+        for ( std::size_t i : order )
+            out << Pitch8ve{ m_pitches[i] } << ' ' << static_cast<double>( m_durations[i] ) / m_quarter_note << '\n';
+    }
+}
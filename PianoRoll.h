@@ -0,0 +1,326 @@
+//)a PianoRoll collects the notes (and tempo changes) of a file as it is decoded, then rasterizes them
+//// into a 128-pitch x frame matrix per plane and writes them to a .npy file
+//)frames are a fixed number of ticks, or a fixed number of seconds (converted through the tempo map)
+//)planes, in order:
+//// dense:  active (0/1), velocity (0-127), onset (0/1, optional), offset (0/1, optional), as uint8 [planes][128][frames]
+//// packed: active, onset (optional), offset (optional), bit-packed like numpy.packbits, as uint8 [planes][128][(frames + 7) / 8];
+////         the real number of frames goes in a sidecar, <file>.npy.json (numpy won't load a .npy header with extra keys),
+////         for numpy.unpackbits(..., count=frames)
+//)a roll is at most max_frames long; a longer one (a malformed file's delta times can put a note hours out) isn't written
+//)each note fills a contiguous span of its pitch's row, so rows are filled a span at a time (memset/fill/max loops)
+//// instead of one cell at a time
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "MIDInotes.h"
+#include "MIDIparser.h"
+
+struct RollOptions
+{
+    //frame width in ticks; if 0, frame_seconds is used instead, and if that is 0 too, a sixteenth note
+    long frame_ticks{ 0 };
+    double frame_seconds{ 0.0 };
+
+    bool onsets{ false };
+    bool offsets{ false };
+
+    bool packed{ false };
+};
+
+class PianoRoll : public NoteListener, public MetaListener
+{
+public:
+    static constexpr int pitches{ 128 };
+
+    //about 4 hours of sixteenth notes at 120 BPM; a dense roll with every plane is then 1 GB
+    static constexpr std::size_t max_frames{ std::size_t{ 1 } << 21 };
+
+    explicit PianoRoll(const RollOptions& options)
+        : m_options{ options }
+    {
+    }
+
+    void setDivision(short quarter_note) override
+    {
+        m_quarter_note = ( quarter_note > 0 ? quarter_note : 1 );
+    }
+
+    void noteFinished(const MIDInote& note) override
+    {
+        int pitch{ note.getPitch().MIDInote() };
+
+        if ( pitch >= 0 && pitch < pitches )
+            m_notes.push_back( Note{ note.onset(), note.onset() + note.duration(), pitch, note.velocity() } );
+    }
+
+    void tempoChange(long tick, double bpm) override
+    {
+        if ( bpm > 0 )
+            m_tempos.push_back( Tempo{ tick, 60.0 / bpm / m_quarter_note, 0.0 } );
+    }
+
+    //rasterize everything collected and write it to path (and the sidecar, if packed);
+    //returns false if it is too long, there isn't the memory for it, or the file can't be written
+    bool write(const std::string& path);
+
+    //why write() failed
+    const std::string& error() const { return m_error; }
+
+private:
+    struct Note
+    {
+        long start{};
+        long end{};
+        int pitch{};
+        int velocity{};
+    };
+
+    //seconds_per_tick from tick on; seconds is the time at tick, filled in before rasterizing
+    struct Tempo
+    {
+        long tick{};
+        double seconds_per_tick{};
+        double seconds{};
+    };
+
+    //position of a tick in frames (fractional)
+    double toFrame(long tick) const;
+
+    void fillDense(std::vector<std::uint8_t>& roll, std::size_t frames) const;
+
+    void fillPacked(std::vector<std::uint8_t>& roll, std::size_t frames) const;
+
+    RollOptions m_options{};
+    short m_quarter_note{ 1 };
+
+    std::vector<Note> m_notes{};
+    std::vector<Tempo> m_tempos{};
+
+    std::string m_error{};
+};
+
+//define PianoRoll member functions
+
+inline double PianoRoll::toFrame(long tick) const
+{
+    if ( m_options.frame_ticks > 0 || m_options.frame_seconds <= 0.0 )
+    {
+        long width{ m_options.frame_ticks > 0 ? m_options.frame_ticks : std::max( m_quarter_note / 4, 1 ) };
+
+        return static_cast<double>(tick) / width;
+    }
+
+    //find the last tempo change at or before tick
+    auto after{ std::upper_bound( m_tempos.begin(), m_tempos.end(), tick,
+                                  [](long t, const Tempo& tempo) { return t < tempo.tick; } ) };
+
+    const Tempo& tempo{ *(after - 1) };
+
+    return ( tempo.seconds + (tick - tempo.tick) * tempo.seconds_per_tick ) / m_options.frame_seconds;
+}
+
+//set bits [first, last) of a packed row, most significant bit first
+inline void setBits(std::uint8_t* row, std::size_t first, std::size_t last)
+{
+    while ( first < last && first % 8 != 0 )
+    {
+        row[first / 8] |= 0x80 >> (first % 8);
+        ++first;
+    }
+
+    if ( last - first >= 8 )
+    {
+        std::memset( row + first / 8, 0xFF, (last - first) / 8 );
+        first += (last - first) / 8 * 8;
+    }
+
+    while ( first < last )
+    {
+        row[first / 8] |= 0x80 >> (first % 8);
+        ++first;
+    }
+}
+
+inline void PianoRoll::fillDense(std::vector<std::uint8_t>& roll, std::size_t frames) const
+{
+    std::size_t plane{ pitches * frames };
+
+    for ( const auto& n : m_notes )
+    {
+        std::size_t first{ static_cast<std::size_t>( toFrame(n.start) ) };
+        std::size_t last{ static_cast<std::size_t>( std::ceil( toFrame(n.end) ) ) };
+
+        //every note covers at least the frame it starts in
+        last = std::min( std::max(last, first + 1), frames );
+        first = std::min( first, frames - 1 );
+
+        std::uint8_t* active{ roll.data() + n.pitch * frames };
+        std::uint8_t* velocity{ active + plane };
+        std::uint8_t velocity_value{ static_cast<std::uint8_t>( std::clamp(n.velocity, 0, 127) ) };
+
+        std::fill( active + first, active + last, std::uint8_t{ 1 } );
+
+        //overlapping notes of the same pitch keep the louder velocity
+        for ( std::size_t f{ first }; f < last; ++f )
+            velocity[f] = std::max( velocity[f], velocity_value );
+
+        std::size_t next{ 2 * plane };
+
+        if ( m_options.onsets )
+        {
+            roll[ next + n.pitch * frames + first ] = 1;
+            next += plane;
+        }
+
+        if ( m_options.offsets )
+            roll[ next + n.pitch * frames + (last - 1) ] = 1;
+    }
+}
+
+inline void PianoRoll::fillPacked(std::vector<std::uint8_t>& roll, std::size_t frames) const
+{
+    std::size_t row_bytes{ (frames + 7) / 8 };
+    std::size_t plane{ pitches * row_bytes };
+
+    for ( const auto& n : m_notes )
+    {
+        std::size_t first{ static_cast<std::size_t>( toFrame(n.start) ) };
+        std::size_t last{ static_cast<std::size_t>( std::ceil( toFrame(n.end) ) ) };
+
+        last = std::min( std::max(last, first + 1), frames );
+        first = std::min( first, frames - 1 );
+
+        setBits( roll.data() + n.pitch * row_bytes, first, last );
+
+        std::size_t next{ plane };
+
+        if ( m_options.onsets )
+        {
+            setBits( roll.data() + next + n.pitch * row_bytes, first, first + 1 );
+            next += plane;
+        }
+
+        if ( m_options.offsets )
+            setBits( roll.data() + next + n.pitch * row_bytes, last - 1, last );
+    }
+}
+
+inline bool PianoRoll::write(const std::string& path)
+{
+    //fill in the time of every tempo change, starting from the default of 120 BPM
+    std::stable_sort( m_tempos.begin(), m_tempos.end(), [](const Tempo& a, const Tempo& b) { return a.tick < b.tick; } );
+
+    if ( m_tempos.empty() || m_tempos.front().tick > 0 )
+        m_tempos.insert( m_tempos.begin(), Tempo{ 0, 0.5 / m_quarter_note, 0.0 } );
+
+    for ( std::size_t t{ 1 }; t < std::size(m_tempos); ++t )
+    {
+        const Tempo& previous{ m_tempos[t - 1] };
+
+        m_tempos[t].seconds = previous.seconds + (m_tempos[t].tick - previous.tick) * previous.seconds_per_tick;
+    }
+
+    long end{ 0 };
+
+    for ( const auto& n : m_notes )
+        end = std::max( end, n.end );
+
+    //compared as a double, so an end far enough out to overflow a size_t is caught too
+    double last_frame{ std::ceil( toFrame(end) ) };
+
+    if ( last_frame > static_cast<double>(max_frames) )
+    {
+        m_error = "piano roll would be " + std::to_string( static_cast<long long>(last_frame) ) + " frames long (at most "
+                  + std::to_string(max_frames) + ")";
+
+        return false;
+    }
+
+    std::size_t frames{ std::max( static_cast<std::size_t>(last_frame), std::size_t{ 1 } ) };
+
+    std::size_t planes{ (m_options.packed ? 1u : 2u) + m_options.onsets + m_options.offsets };
+    std::size_t row{ m_options.packed ? (frames + 7) / 8 : frames };
+
+    std::vector<std::uint8_t> roll{};
+
+    try
+    {
+        roll.resize( planes * pitches * row );
+    }
+    catch ( const std::bad_alloc& )
+    {
+        m_error = "not enough memory for a piano roll of " + std::to_string(frames) + " frames";
+
+        return false;
+    }
+
+    if ( m_options.packed )
+        fillPacked( roll, frames );
+    else
+        fillDense( roll, frames );
+
+    std::ofstream outf{ path, std::ios::binary };
+
+    if ( !outf )
+    {
+        m_error = "could not be opened for writing";
+
+        return false;
+    }
+
+    //.npy version 1.0: magic, header length, then a Python dict padded with spaces to a multiple of 64 bytes
+    std::string header{ "{'descr': '|u1', 'fortran_order': False, 'shape': (" + std::to_string(planes) + ", "
+                        + std::to_string(pitches) + ", " + std::to_string(row) + "), }" };
+
+    std::size_t unpadded{ 10 + std::size(header) + 1 };
+    header.append( (64 - unpadded % 64) % 64, ' ' );
+    header += '\n';
+
+    std::uint16_t length{ static_cast<std::uint16_t>( std::size(header) ) };
+
+    outf.write( "\x93NUMPY\x01\x00", 8 );
+    outf.put( static_cast<char>( length & 0xFF ) );
+    outf.put( static_cast<char>( length >> 8 ) );
+    outf << header;
+    outf.write( reinterpret_cast<const char*>( roll.data() ), static_cast<std::streamsize>( std::size(roll) ) );
+
+    if ( !outf )
+    {
+        m_error = "could not be written";
+
+        return false;
+    }
+
+    if ( !m_options.packed )
+        return true;
+
+    std::ofstream sidecar{ path + ".json" };
+
+    sidecar << "{\"frames\": " << frames << ", \"planes\": [\"active\"";
+
+    if ( m_options.onsets )
+        sidecar << ", \"onset\"";
+
+    if ( m_options.offsets )
+        sidecar << ", \"offset\"";
+
+    sidecar << "]}\n";
+
+    if ( !sidecar )
+    {
+        m_error = "frame count could not be written to " + path + ".json";
+
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,137 @@
+//)a TrackBuffer holds the bytes of a single track (everything up to and including the byte after FF 2F),
+//// read from the file on demand
+//)with a window of 0, the whole track is read the first time a byte is asked for
+//)with a non-zero window, bytes are read that many at a time, and release() lets go of
+//// bytes the parser has moved past, so only about two windows are ever resident
+//)indices are always relative to the start of the track, whatever has been released
+
+#pragma once
+
+#include <algorithm>
+#include <istream>
+#include <string_view>
+#include <vector>
+
+class TrackBuffer
+{
+public:
+    TrackBuffer(std::istream& inf, std::size_t window=0)
+        : m_inf{ inf }
+        , m_window{ window }
+    {
+    }
+
+    //returns whether there is a byte at index i, reading more of the track if necessary
+    bool has(std::size_t i)
+    {
+        while ( i >= end() && !m_complete )
+            fill();
+
+        return ( i < end() );
+    }
+
+    //reading past the end of the track gives 0 instead of undefined behaviour
+    int operator[](std::size_t i)
+    {
+        return has(i) ? int( m_bytes[i - m_base] ) : 0;
+    }
+
+    //the bytes [i, i + n) as text, cut short at the end of the track; reading more of the track or releasing
+    //bytes can move them, so the view is only good until the buffer is used again
+    std::string_view view(std::size_t i, std::size_t n)
+    {
+        if ( n == 0 || !has(i) )
+            return {};
+
+        has( i + n - 1 );
+
+        return std::string_view{ m_bytes.data() + (i - m_base), std::min( n, end() - i ) };
+    }
+
+    bool empty() { return !has(0); }
+
+    //the number of bytes in the track, reading the rest of it; once it has all been read,
+    //several threads can read the buffer at the same time
+    std::size_t size()
+    {
+        while ( !m_complete )
+            fill();
+
+        return end();
+    }
+
+    //the parser looks back at most a few bytes (for the previous status byte),
+    //so keep a small margin behind i and drop the rest once a full window can be dropped
+    void release(std::size_t i)
+    {
+        if ( m_window == 0 || i < m_base + m_window + margin )
+            return;
+
+        std::size_t drop{ i - margin - m_base };
+
+        m_bytes.erase( m_bytes.begin(), m_bytes.begin() + drop );
+        m_base += drop;
+    }
+
+    std::size_t memoryUsage() const { return m_bytes.capacity(); }
+
+private:
+    static constexpr std::size_t margin{ 16 };
+
+    std::size_t end() const { return m_base + std::size(m_bytes); }
+
+    //read the next window (or the rest of the track), stopping at the end of the track
+    void fill();
+
+    std::istream& m_inf;
+    std::size_t m_window{};
+
+    std::vector<char> m_bytes{};
+
+    //track index of m_bytes[0]
+    std::size_t m_base{ 0 };
+
+    //the end of a track is FF 2F followed by its length byte
+    bool m_e_gate{ false };
+    bool m_p_gate{ false };
+    bool m_complete{ false };
+};
+
+inline void TrackBuffer::fill()
+{
+    char c{};
+    std::size_t count{ 0 };
+
+    while ( m_window == 0 || count < m_window )
+    {
+        if ( !(m_inf >> c) )
+        {
+            m_complete = true;
+            break;
+        }
+
+        m_bytes.push_back( c );
+        ++count;
+
+        if ( m_p_gate )
+        {
+            m_complete = true;
+            break;
+        }
+
+        if ( m_e_gate )
+        {
+            if ( c == char(0x2F) )
+            {
+                m_p_gate = true;
+            }
+
+            m_e_gate = false;
+        }
+
+        if ( c == char(0xFF) )
+        {
+            m_e_gate = true;
+        }
+    }
+}
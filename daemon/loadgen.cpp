@@ -0,0 +1,160 @@
+//load generator for the parse daemon: several clients send parse requests for the given files as fast as they can,
+//then the client-side throughput and latencies are printed along with the daemon's own stats
+//
+//    g++ -O2 -pthread loadgen.cpp -o loadgen
+//    ./loadgen <socket path> <clients> <requests per client> file.mid ...
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "protocol.h"
+
+//most clients, and requests per client, that can be asked for
+constexpr std::size_t max_clients{ 1024 };
+constexpr std::size_t max_requests{ 100'000'000 };
+
+double percentile(std::vector<double>& samples, double fraction)
+{
+    if ( samples.empty() )
+        return 0.0;
+
+    auto nth{ samples.begin() + static_cast<std::ptrdiff_t>( fraction * (std::size(samples) - 1) ) };
+    std::nth_element( samples.begin(), nth, samples.end() );
+
+    return *nth;
+}
+
+int main(int argc, char* argv[])
+{
+    if ( argc < 5 )
+    {
+        std::cerr << "usage: " << argv[0] << " <socket path> <clients> <requests per client> file.mid ...\n";
+
+        return 1;
+    }
+
+    std::signal( SIGPIPE, SIG_IGN );
+
+    std::string socket_path{ argv[1] };
+    std::size_t clients{ parseCount( argv[2], max_clients ) };
+    std::size_t requests{ parseCount( argv[3], max_requests ) };
+
+    if ( clients == 0 || requests == 0 )
+    {
+        std::cerr << "Invalid number of clients (1-" << max_clients << ") or requests per client (1-" << max_requests
+                  << "): " << argv[2] << ' ' << argv[3] << '\n';
+
+        return 1;
+    }
+
+    std::vector<std::string> filenames( argc - 4 );
+
+    //the daemon reads the files itself, from its own working directory
+    for ( int arg{ 4 }; arg < argc; ++arg )
+    {
+        if ( !absolutePath(argv[arg], filenames[arg - 4]) )
+        {
+            std::cerr << argv[arg] << " could not be found\n";
+
+            return 1;
+        }
+    }
+
+    //every client keeps its own latencies, merged once they are all done
+    std::vector<std::vector<double>> latencies( clients );
+    std::atomic<std::size_t> failures{ 0 };
+
+    auto start{ std::chrono::steady_clock::now() };
+
+    std::vector<std::thread> threads{};
+
+    for ( std::size_t c{ 0 }; c < clients; ++c )
+    {
+        threads.emplace_back( [&, c]
+        {
+            int fd{ connectTo(socket_path) };
+
+            if ( fd < 0 )
+            {
+                failures += requests;
+
+                return;
+            }
+
+            Response response{};
+            std::vector<char> body{};
+
+            for ( std::size_t r{ 0 }; r < requests; ++r )
+            {
+                const std::string& filename{ filenames[ (c + r) % std::size(filenames) ] };
+
+                Request request{};
+                request.op = parse_path;
+                request.length = static_cast<std::uint32_t>( std::size(filename) );
+
+                auto sent{ std::chrono::steady_clock::now() };
+
+                if ( !roundTrip(fd, request, filename.data(), response, body) )
+                {
+                    failures += requests - r;
+
+                    break;
+                }
+
+                std::chrono::duration<double, std::micro> elapsed{ std::chrono::steady_clock::now() - sent };
+                latencies[c].push_back( elapsed.count() );
+
+                if ( response.status != status_ok )
+                    ++failures;
+            }
+
+            ::close(fd);
+        } );
+    }
+
+    for ( auto& t : threads )
+        t.join();
+
+    std::chrono::duration<double> total{ std::chrono::steady_clock::now() - start };
+
+    std::vector<double> all{};
+
+    for ( const auto& l : latencies )
+        all.insert( all.end(), l.begin(), l.end() );
+
+    std::cout << "Requests: " << std::size(all) << " (" << failures << " failed) in " << total.count() << " s\n";
+    std::cout << "Throughput: " << std::size(all) / total.count() << " requests/s\n";
+    std::cout << "Client p50 latency: " << percentile(all, 0.50) << " us\n";
+    std::cout << "Client p99 latency: " << percentile(all, 0.99) << " us\n";
+
+    int fd{ connectTo(socket_path) };
+
+    Request request{};
+    request.op = get_stats;
+
+    Response response{};
+    std::vector<char> body{};
+    Stats stats{};
+    std::size_t offset{ 0 };
+
+    if ( fd >= 0 && roundTrip(fd, request, nullptr, response, body) && get(body, offset, stats) )
+    {
+        std::uint64_t lookups{ stats.cache_hits + stats.cache_misses };
+
+        std::cout << "Daemon p50 latency: " << stats.p50 << " us\n";
+        std::cout << "Daemon p99 latency: " << stats.p99 << " us\n";
+        std::cout << "Daemon cache hit rate: " << ( lookups ? 100.0 * stats.cache_hits / lookups : 0.0 ) << "%\n";
+    }
+
+    if ( fd >= 0 )
+        ::close(fd);
+
+    return ( failures > 0 ) ? 1 : 0;
+}
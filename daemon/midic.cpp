@@ -0,0 +1,208 @@
+//client for the parse daemon
+//
+//    g++ -O2 midic.cpp -o midic
+//    ./midic <socket path> parse <file>         ask the daemon to read and parse a file (sent as an absolute path)
+//    ./midic <socket path> send <file>          send the file's bytes to be parsed
+//    ./midic <socket path> stats                print the daemon's request latencies and cache hit rate
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "protocol.h"
+
+//print a summary of a parse response: per track, the number of notes and the text events,
+//then the size of every level of the density pyramid
+bool printParse(const std::vector<char>& body)
+{
+    std::size_t offset{ 0 };
+
+    std::uint32_t division{};
+    std::uint32_t tracks{};
+
+    if ( !get(body, offset, division) || !get(body, offset, tracks) )
+        return false;
+
+    std::cout << "Ticks per quarter note: " << division << '\n';
+    std::cout << "Number of tracks: " << tracks << '\n';
+
+    for ( std::uint32_t t{ 0 }; t < tracks; ++t )
+    {
+        std::uint32_t notes{};
+        std::uint32_t meta{};
+
+        if ( !get(body, offset, notes) || !get(body, offset, meta) )
+            return false;
+
+        std::cout << "\nTrack " << t << ": " << notes << " notes, " << meta << " meta events\n";
+
+        //each note is { i64 onset, i64 duration, u8 channel, u8 pitch, u8 velocity }
+        offset += static_cast<std::size_t>(notes) * 19;
+
+        for ( std::uint32_t m{ 0 }; m < meta; ++m )
+        {
+            std::int64_t tick{};
+            std::uint8_t type{};
+            double bpm{};
+            std::int32_t first{};
+            std::int32_t second{};
+            std::uint32_t length{};
+
+            if ( !get(body, offset, tick) || !get(body, offset, type) || !get(body, offset, bpm)
+                 || !get(body, offset, first) || !get(body, offset, second) || !get(body, offset, length)
+                 || offset + length > std::size(body) )
+                return false;
+
+            if ( type == 0x51 )
+                std::cout << '\t' << tick << ": " << bpm << " BPM\n";
+            else if ( length )
+                std::cout << '\t' << tick << ": " << std::string_view{ body.data() + offset, length } << '\n';
+
+            offset += length;
+        }
+    }
+
+    std::uint32_t levels{};
+
+    if ( !get(body, offset, levels) )
+        return false;
+
+    std::cout << "\nNote density:\n";
+
+    for ( std::uint32_t l{ 0 }; l < levels; ++l )
+    {
+        std::int64_t bucket_ticks{};
+        std::uint32_t buckets{};
+
+        if ( !get(body, offset, bucket_ticks) || !get(body, offset, buckets) )
+            return false;
+
+        std::cout << "\tLevel " << l << ": " << bucket_ticks << " ticks per bucket, " << buckets << " buckets\n";
+
+        //each bucket is { u32 notes, u16 polyphony, u8 low, u8 high, u8 velocity }
+        offset += static_cast<std::size_t>(buckets) * 9;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if ( argc < 3 )
+    {
+        std::cerr << "usage: " << argv[0] << " <socket path> parse <file> | send <file> | stats\n";
+
+        return 1;
+    }
+
+    std::string_view command{ argv[2] };
+
+    Request request{};
+    std::vector<char> payload{};
+
+    if ( (command == "parse" || command == "send") && argc > 3 )
+    {
+        if ( command == "parse" )
+        {
+            std::string path{};
+
+            if ( !absolutePath(argv[3], path) )
+            {
+                std::cerr << argv[3] << " could not be found\n";
+
+                return 1;
+            }
+
+            request.op = parse_path;
+            payload.assign( path.begin(), path.end() );
+        }
+        else
+        {
+            std::ifstream inf{ argv[3], std::ios::binary };
+
+            if ( !inf )
+            {
+                std::cerr << argv[3] << " could not be opened for reading\n";
+
+                return 1;
+            }
+
+            request.op = parse_bytes;
+            payload.assign( std::istreambuf_iterator<char>{ inf }, std::istreambuf_iterator<char>{} );
+        }
+    }
+    else if ( command == "stats" )
+    {
+        request.op = get_stats;
+    }
+    else
+    {
+        std::cerr << "Unknown command: " << command << '\n';
+
+        return 1;
+    }
+
+    request.length = static_cast<std::uint32_t>( std::size(payload) );
+    request.tables |= density_table;
+
+    int fd{ connectTo(argv[1]) };
+
+    if ( fd < 0 )
+    {
+        std::cerr << "Error: could not connect to " << argv[1] << '\n';
+
+        return 1;
+    }
+
+    Response response{};
+    std::vector<char> body{};
+
+    bool sent{ roundTrip(fd, request, payload.data(), response, body) };
+
+    ::close(fd);
+
+    if ( !sent )
+    {
+        std::cerr << "Error: connection to the daemon failed\n";
+
+        return 1;
+    }
+
+    if ( response.status != status_ok )
+    {
+        std::cerr << "Error: request failed with status " << response.status << '\n';
+
+        return 1;
+    }
+
+    if ( request.op == get_stats )
+    {
+        Stats stats{};
+        std::size_t offset{ 0 };
+
+        if ( !get(body, offset, stats) )
+            return 1;
+
+        std::uint64_t lookups{ stats.cache_hits + stats.cache_misses };
+
+        std::cout << "Requests: " << stats.requests << '\n';
+        std::cout << "p50 latency: " << stats.p50 << " us\n";
+        std::cout << "p99 latency: " << stats.p99 << " us\n";
+        std::cout << "Cache hit rate: " << ( lookups ? 100.0 * stats.cache_hits / lookups : 0.0 ) << "% ("
+                  << stats.cached_files << " files cached)\n";
+
+        return 0;
+    }
+
+    if ( !printParse(body) )
+    {
+        std::cerr << "Error: malformed response\n";
+
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,752 @@
+//long-running parse daemon: keeps a pool of workers and a cache of parsed files warm,
+//and answers requests (see protocol.h) over a Unix domain socket
+//
+//    g++ -O2 -pthread midid.cpp ../header.cpp ../tracks.cpp ../midi_capi.cpp -o midid
+//    ./midid /tmp/midid.sock [--workers=<n>] [--cache=<megabytes>] [--idle=<seconds>] [--mode=<octal>] [--segments=<n>]
+//
+//)the main thread polls every open connection; when a request arrives on one, the connection is handed to a worker
+//// for that one request and comes back to the poll afterwards, so idle clients don't hold on to a worker
+//// (and are hung up on after --idle seconds, 60 by default); stats requests are answered by the main thread itself,
+//// so they come back however busy the workers are
+//)a client that stops halfway through sending a request (or reading a response) is hung up on after io_timeout,
+//// and at most max_connections are kept open; further clients wait in the socket's backlog
+//)parsed files are kept in an LRU cache of at most --cache megabytes (256 by default): by path (with size and mtime,
+//// so edited files are parsed again) or by a hash of the content for inline bytes, which keeps a copy of the content
+//// to check a hit against, so two files whose hashes collide never share a result
+//)the socket is only usable by the daemon's own user (mode 0600) unless --mode says otherwise
+//)with --segments, a worker decodes a large track in up to that many parts at once (see midi_open_file_ex),
+//// which helps when there are fewer big files being parsed than cores
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../midi_capi.h"
+#include "protocol.h"
+
+using ParsedFile = std::shared_ptr<const midi_file>;
+
+//seconds a worker waits for the rest of a request, or for the client to take a response, before hanging up
+constexpr int io_timeout{ 5 };
+
+//open connections, idle or not; while there are this many the daemon stops accepting
+constexpr std::size_t max_connections{ 1024 };
+
+//roughly how many bytes a parsed file takes
+std::size_t footprint(const midi_file* file)
+{
+    std::size_t bytes{ 0 };
+
+    for ( std::size_t t{ 0 }; t < midi_track_count(file); ++t )
+    {
+        std::size_t note_count{ 0 };
+        std::size_t meta_count{ 0 };
+
+        midi_notes( file, t, &note_count );
+        const midi_meta* meta{ midi_meta_events(file, t, &meta_count) };
+
+        bytes += note_count * sizeof(midi_note) + meta_count * sizeof(midi_meta);
+
+        for ( std::size_t m{ 0 }; m < meta_count; ++m )
+            bytes += meta[m].length;
+    }
+
+    for ( std::size_t l{ 0 }; l < midi_density_levels(file); ++l )
+    {
+        std::size_t count{ 0 };
+
+        midi_density( file, l, &count, nullptr );
+        bytes += count * sizeof(midi_density_bucket);
+    }
+
+    return bytes;
+}
+
+//create class to hold the most recently used parsed files, up to a number of bytes of them
+
+class FileCache
+{
+public:
+    explicit FileCache(std::size_t capacity)
+        : m_capacity{ capacity }
+    {
+    }
+
+    //returns the cached file, or parses it with parse() (outside the lock) and caches the result;
+    //content is what the file is parsed from if the key is only a hash of it (empty otherwise),
+    //and a hit only counts if it was parsed from the same content
+    ParsedFile find(const std::string& key, std::string_view content, const std::function<midi_file*()>& parse);
+
+    std::uint64_t hits() const { std::lock_guard lock{ m_mutex }; return m_hits; }
+
+    std::uint64_t misses() const { std::lock_guard lock{ m_mutex }; return m_misses; }
+
+    std::size_t size() const { std::lock_guard lock{ m_mutex }; return std::size(m_entries); }
+
+private:
+    struct Entry
+    {
+        std::string key{};
+        ParsedFile file{};
+        std::vector<char> content{};
+
+        //the file's footprint and its content
+        std::size_t bytes{};
+    };
+
+    std::size_t m_capacity{};
+    std::size_t m_bytes{ 0 };
+
+    //most recently used at the front
+    std::list<Entry> m_entries{};
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> m_index{};
+
+    std::uint64_t m_hits{ 0 };
+    std::uint64_t m_misses{ 0 };
+
+    mutable std::mutex m_mutex{};
+};
+
+ParsedFile FileCache::find(const std::string& key, std::string_view content, const std::function<midi_file*()>& parse)
+{
+    {
+        std::lock_guard lock{ m_mutex };
+
+        auto found{ m_index.find(key) };
+
+        if ( found != m_index.end()
+             && std::equal( content.begin(), content.end(), found->second->content.begin(), found->second->content.end() ) )
+        {
+            m_entries.splice( m_entries.begin(), m_entries, found->second );
+            ++m_hits;
+
+            return found->second->file;
+        }
+
+        ++m_misses;
+    }
+
+    ParsedFile file{ parse(), midi_close };
+
+    if ( !file )
+        return file;
+
+    std::size_t bytes{ footprint( file.get() ) + std::size(content) };
+
+    if ( bytes > m_capacity )
+        return file;
+
+    std::lock_guard lock{ m_mutex };
+
+    //another worker may have parsed the same file in the meantime (or a colliding one is cached under the key)
+    if ( m_index.count(key) )
+        return file;
+
+    m_entries.push_front( Entry{ key, file, std::vector<char>( content.begin(), content.end() ), bytes } );
+    m_index[ m_entries.front().key ] = m_entries.begin();
+    m_bytes += bytes;
+
+    while ( m_bytes > m_capacity )
+    {
+        m_bytes -= m_entries.back().bytes;
+        m_index.erase( m_entries.back().key );
+        m_entries.pop_back();
+    }
+
+    return file;
+}
+
+//create class to keep the latencies of the most recent requests
+
+class LatencyLog
+{
+public:
+    void record(double microseconds)
+    {
+        std::lock_guard lock{ m_mutex };
+
+        if ( std::size(m_samples) < window )
+            m_samples.push_back( microseconds );
+        else
+            m_samples[ m_next % window ] = microseconds;
+
+        ++m_next;
+    }
+
+    std::uint64_t count() const { std::lock_guard lock{ m_mutex }; return m_next; }
+
+    //the latency under which the given fraction of recent requests finished
+    double percentile(double fraction) const;
+
+private:
+    static constexpr std::size_t window{ 4096 };
+
+    std::vector<double> m_samples{};
+    std::uint64_t m_next{ 0 };
+
+    mutable std::mutex m_mutex{};
+};
+
+double LatencyLog::percentile(double fraction) const
+{
+    std::vector<double> samples{};
+
+    {
+        std::lock_guard lock{ m_mutex };
+        samples = m_samples;
+    }
+
+    if ( samples.empty() )
+        return 0.0;
+
+    auto nth{ samples.begin() + static_cast<std::ptrdiff_t>( fraction * (std::size(samples) - 1) ) };
+    std::nth_element( samples.begin(), nth, samples.end() );
+
+    return *nth;
+}
+
+//create class to hand connections with a request waiting to the workers;
+//each one keeps the time it was queued, so a request's latency includes its wait for a worker
+
+struct Waiting
+{
+    int fd{};
+    std::chrono::steady_clock::time_point queued{};
+};
+
+class ConnectionQueue
+{
+public:
+    void push(int fd)
+    {
+        {
+            std::lock_guard lock{ m_mutex };
+            m_waiting.push_back( Waiting{ fd, std::chrono::steady_clock::now() } );
+        }
+
+        m_ready.notify_one();
+    }
+
+    Waiting pop()
+    {
+        std::unique_lock lock{ m_mutex };
+        m_ready.wait( lock, [this] { return !m_waiting.empty(); } );
+
+        Waiting w{ m_waiting.front() };
+        m_waiting.pop_front();
+
+        return w;
+    }
+
+private:
+    std::deque<Waiting> m_waiting{};
+
+    std::mutex m_mutex{};
+    std::condition_variable m_ready{};
+};
+
+//write the tables asked for into a response payload
+void serialize(const midi_file* file, std::uint8_t tables, std::vector<char>& out)
+{
+    std::size_t tracks{ midi_track_count(file) };
+
+    put( out, static_cast<std::uint32_t>( midi_division(file) ) );
+    put( out, static_cast<std::uint32_t>( tracks ) );
+
+    for ( std::size_t t{ 0 }; t < tracks; ++t )
+    {
+        std::size_t note_count{ 0 };
+        std::size_t meta_count{ 0 };
+
+        const midi_note* notes{ midi_notes(file, t, &note_count) };
+        const midi_meta* meta{ midi_meta_events(file, t, &meta_count) };
+
+        if ( !(tables & notes_table) )
+            note_count = 0;
+
+        if ( !(tables & meta_table) )
+            meta_count = 0;
+
+        put( out, static_cast<std::uint32_t>( note_count ) );
+        put( out, static_cast<std::uint32_t>( meta_count ) );
+
+        for ( std::size_t n{ 0 }; n < note_count; ++n )
+        {
+            put( out, static_cast<std::int64_t>( notes[n].onset ) );
+            put( out, static_cast<std::int64_t>( notes[n].duration ) );
+            put( out, notes[n].channel );
+            put( out, notes[n].pitch );
+            put( out, notes[n].velocity );
+        }
+
+        for ( std::size_t m{ 0 }; m < meta_count; ++m )
+        {
+            put( out, static_cast<std::int64_t>( meta[m].tick ) );
+            put( out, meta[m].type );
+            put( out, meta[m].bpm );
+            put( out, static_cast<std::int32_t>( meta[m].first ) );
+            put( out, static_cast<std::int32_t>( meta[m].second ) );
+            put( out, static_cast<std::uint32_t>( meta[m].length ) );
+
+            if ( meta[m].length )
+                out.insert( out.end(), meta[m].text, meta[m].text + meta[m].length );
+        }
+    }
+
+    if ( !(tables & density_table) )
+        return;
+
+    std::size_t levels{ midi_density_levels(file) };
+
+    put( out, static_cast<std::uint32_t>( levels ) );
+
+    for ( std::size_t l{ 0 }; l < levels; ++l )
+    {
+        std::size_t count{ 0 };
+        std::int64_t bucket_ticks{ 0 };
+
+        const midi_density_bucket* buckets{ midi_density(file, l, &count, &bucket_ticks) };
+
+        put( out, bucket_ticks );
+        put( out, static_cast<std::uint32_t>( count ) );
+
+        for ( std::size_t b{ 0 }; b < count; ++b )
+        {
+            put( out, buckets[b].notes );
+            put( out, buckets[b].polyphony );
+            put( out, buckets[b].low );
+            put( out, buckets[b].high );
+            put( out, buckets[b].velocity );
+        }
+    }
+}
+
+struct Daemon
+{
+    FileCache cache;
+    LatencyLog latencies{};
+    ConnectionQueue queue;
+
+    //parts a large track is decoded in at once
+    std::size_t segments{ 1 };
+
+    //answer one request; returns the status to send back, with its payload in out
+    Status handle(const Request& request, const std::vector<char>& payload, std::vector<char>& out);
+
+    //serve the request waiting on a connection, timing it from when it was queued;
+    //returns false if the connection was closed
+    bool serve(const Waiting& waiting);
+
+    //answer a stats request waiting on a connection without handing it to a worker;
+    //returns false if the next request is anything else (or hasn't fully arrived yet)
+    bool answerStats(int fd);
+};
+
+Status Daemon::handle(const Request& request, const std::vector<char>& payload, std::vector<char>& out)
+{
+    ParsedFile file{};
+
+    switch ( request.op )
+    {
+    case parse_path:
+    {
+        std::string path( payload.begin(), payload.end() );
+
+        if ( path.empty() || path.front() != '/' )
+            return bad_request;
+
+        struct stat info{};
+
+        if ( ::stat(path.c_str(), &info) != 0 )
+            return unreadable;
+
+        std::string key{ "path:" + path + ':' + std::to_string(info.st_size) + ':' + std::to_string(info.st_mtime) };
+
+        file = cache.find( key, {}, [this, &path] { return midi_open_file_ex( path.c_str(), segments ); } );
+        break;
+    }
+    case parse_bytes:
+    {
+        std::string_view content{ payload.data(), std::size(payload) };
+        std::string key{ "bytes:" + std::to_string( std::hash<std::string_view>{}(content) ) + ':' + std::to_string( std::size(payload) ) };
+
+        file = cache.find( key, content, [this, &payload] { return midi_open_memory_ex( payload.data(), std::size(payload), segments ); } );
+        break;
+    }
+    case get_stats:
+    {
+        Stats stats{};
+        stats.requests = latencies.count();
+        stats.cache_hits = cache.hits();
+        stats.cache_misses = cache.misses();
+        stats.cached_files = std::size( cache );
+        stats.p50 = latencies.percentile( 0.50 );
+        stats.p99 = latencies.percentile( 0.99 );
+
+        put( out, stats );
+
+        return status_ok;
+    }
+    default:
+        return bad_request;
+    }
+
+    if ( !file )
+        return unreadable;
+
+    serialize( file.get(), request.tables, out );
+
+    return status_ok;
+}
+
+bool Daemon::serve(const Waiting& waiting)
+{
+    int fd{ waiting.fd };
+
+    Request request{};
+    std::vector<char> payload{};
+    std::vector<char> out{};
+
+    if ( !readAll(fd, &request, sizeof(request)) )
+    {
+        ::close(fd);
+
+        return false;
+    }
+
+    Response response{};
+
+    if ( request.length > max_request )
+    {
+        //the rest of the request can't be skipped reliably, so answer and hang up
+        response.status = too_large;
+        writeAll(fd, &response, sizeof(response));
+
+        ::close(fd);
+
+        return false;
+    }
+
+    payload.resize( request.length );
+
+    if ( !readAll(fd, payload.data(), request.length) )
+    {
+        ::close(fd);
+
+        return false;
+    }
+
+    response.status = handle(request, payload, out);
+    response.length = static_cast<std::uint32_t>( std::size(out) );
+
+    if ( !writeAll(fd, &response, sizeof(response)) || !writeAll(fd, out.data(), std::size(out)) )
+    {
+        ::close(fd);
+
+        return false;
+    }
+
+    //stats requests would only dilute the parse latencies
+    if ( request.op != get_stats )
+    {
+        std::chrono::duration<double, std::micro> elapsed{ std::chrono::steady_clock::now() - waiting.queued };
+        latencies.record( elapsed.count() );
+    }
+
+    return true;
+}
+
+bool Daemon::answerStats(int fd)
+{
+    Request request{};
+
+    ssize_t n{ ::recv(fd, &request, sizeof(request), MSG_PEEK | MSG_DONTWAIT) };
+
+    if ( n != static_cast<ssize_t>( sizeof(request) ) || request.op != get_stats || request.length != 0 )
+        return false;
+
+    std::vector<char> out{};
+
+    readAll(fd, &request, sizeof(request));
+
+    Response response{};
+    response.status = handle(request, {}, out);
+    response.length = static_cast<std::uint32_t>( std::size(out) );
+
+    //the response is small enough to go straight into the socket's buffer; if it doesn't,
+    //the connection is broken and the next poll will see it hang up
+    if ( writeAll(fd, &response, sizeof(response)) )
+        writeAll(fd, out.data(), std::size(out));
+
+    return true;
+}
+
+//most workers (and segments), cache megabytes and idle seconds the options can ask for
+constexpr std::size_t max_workers{ 256 };
+constexpr std::size_t max_cache_megabytes{ 1024 * 1024 };
+constexpr std::size_t max_idle_seconds{ 24 * 60 * 60 };
+
+//parse a socket mode (octal digits, at most 0777); returns false if it can't be parsed
+bool parseMode(std::string_view s, mode_t& mode)
+{
+    mode_t m{ 0 };
+
+    if ( s.empty() )
+        return false;
+
+    for ( char c : s )
+    {
+        if ( c < '0' || c > '7' )
+            return false;
+
+        m = m * 8 + static_cast<mode_t>(c - '0');
+
+        if ( m > 0777 )
+            return false;
+    }
+
+    mode = m;
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if ( argc < 2 )
+    {
+        std::cerr << "usage: " << argv[0] << " <socket path> [--workers=<n>] [--cache=<megabytes>] [--idle=<seconds>] [--mode=<octal>]"
+                     " [--segments=<n>]\n";
+
+        return 1;
+    }
+
+    std::string socket_path{ argv[1] };
+
+    std::size_t workers{ std::max( std::thread::hardware_concurrency(), 1u ) };
+    std::size_t cache_megabytes{ 256 };
+    std::size_t idle_seconds{ 60 };
+    mode_t socket_mode{ 0600 };
+    std::size_t segments{ 1 };
+
+    for ( int arg{ 2 }; arg < argc; ++arg )
+    {
+        std::string_view a{ argv[arg] };
+
+        if ( a.substr(0, 10) == "--workers=" )
+        {
+            workers = parseCount( a.substr(10), max_workers );
+
+            if ( workers == 0 )
+            {
+                std::cerr << "Invalid number of workers (1-" << max_workers << "): " << a.substr(10) << '\n';
+
+                return 1;
+            }
+        }
+        else if ( a.substr(0, 8) == "--cache=" )
+        {
+            cache_megabytes = parseCount( a.substr(8), max_cache_megabytes );
+
+            if ( cache_megabytes == 0 )
+            {
+                std::cerr << "Invalid cache size (1-" << max_cache_megabytes << " megabytes): " << a.substr(8) << '\n';
+
+                return 1;
+            }
+        }
+        else if ( a.substr(0, 7) == "--idle=" )
+        {
+            idle_seconds = parseCount( a.substr(7), max_idle_seconds );
+
+            if ( idle_seconds == 0 )
+            {
+                std::cerr << "Invalid idle time (1-" << max_idle_seconds << " seconds): " << a.substr(7) << '\n';
+
+                return 1;
+            }
+        }
+        else if ( a.substr(0, 7) == "--mode=" )
+        {
+            if ( !parseMode( a.substr(7), socket_mode ) )
+            {
+                std::cerr << "Invalid socket mode (octal, at most 0777): " << a.substr(7) << '\n';
+
+                return 1;
+            }
+        }
+        else if ( a.substr(0, 11) == "--segments=" )
+        {
+            segments = parseCount( a.substr(11), max_workers );
+
+            if ( segments == 0 )
+            {
+                std::cerr << "Invalid number of segments (1-" << max_workers << "): " << a.substr(11) << '\n';
+
+                return 1;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << a << '\n';
+
+            return 1;
+        }
+    }
+
+    std::signal( SIGPIPE, SIG_IGN );
+
+    int listener{ ::socket(AF_UNIX, SOCK_STREAM, 0) };
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy( address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1 );
+
+    ::unlink( socket_path.c_str() );
+
+    //the mode is set before listening, so no one else can connect in between
+    if ( listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+         || ::chmod(socket_path.c_str(), socket_mode) < 0 || ::listen(listener, 64) < 0 )
+    {
+        std::cerr << "Error: could not listen on " << socket_path << '\n';
+
+        return 1;
+    }
+
+    //workers hand connections back through this pipe: the fd to keep polling it, or -1 if they closed it
+    int returned[2]{};
+
+    if ( ::pipe(returned) < 0 )
+    {
+        std::cerr << "Error: could not create a pipe\n";
+
+        return 1;
+    }
+
+    Daemon daemon{ FileCache{ cache_megabytes * 1024 * 1024 }, LatencyLog{}, ConnectionQueue{}, segments };
+
+    std::vector<std::thread> pool{};
+
+    for ( std::size_t w{ 0 }; w < workers; ++w )
+    {
+        pool.emplace_back( [&daemon, &returned]
+        {
+            while ( true )
+            {
+                Waiting waiting{ daemon.queue.pop() };
+                int back{ daemon.serve(waiting) ? waiting.fd : -1 };
+
+                //writes this small to a pipe are never split, and send() only works on sockets
+                while ( ::write(returned[1], &back, sizeof(back)) < 0 && errno == EINTR )
+                {
+                }
+            }
+        } );
+    }
+
+    std::cerr << "Listening on " << socket_path << " with " << workers << " workers\n";
+
+    using Clock = std::chrono::steady_clock;
+
+    //connections waiting for their next request, with the time they became idle
+    std::unordered_map<int, Clock::time_point> idle{};
+    std::size_t open{ 0 };
+
+    timeval timeout{ io_timeout, 0 };
+
+    std::vector<pollfd> polled{};
+
+    while ( true )
+    {
+        polled.clear();
+        polled.push_back( pollfd{ returned[0], POLLIN, 0 } );
+
+        if ( open < max_connections )
+            polled.push_back( pollfd{ listener, POLLIN, 0 } );
+
+        for ( const auto& [fd, since] : idle )
+            polled.push_back( pollfd{ fd, POLLIN, 0 } );
+
+        //wake up every second to hang up on idle clients
+        if ( ::poll(polled.data(), std::size(polled), 1000) < 0 )
+            continue;
+
+        auto now{ Clock::now() };
+
+        for ( const auto& p : polled )
+        {
+            if ( !p.revents )
+                continue;
+
+            if ( p.fd == returned[0] )
+            {
+                int back{};
+
+                if ( !readAll(returned[0], &back, sizeof(back)) )
+                    continue;
+
+                if ( back < 0 )
+                    --open;
+                else
+                    idle[back] = now;
+            }
+            else if ( p.fd == listener )
+            {
+                int fd{ ::accept(listener, nullptr, nullptr) };
+
+                if ( fd < 0 )
+                    continue;
+
+                ::setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout) );
+                ::setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout) );
+
+                idle[fd] = now;
+                ++open;
+            }
+            else if ( (p.revents & POLLIN) && daemon.answerStats(p.fd) )
+            {
+                idle[p.fd] = now;
+            }
+            else
+            {
+                //the worker finds out if the client hung up instead
+                idle.erase( p.fd );
+                daemon.queue.push( p.fd );
+            }
+        }
+
+        for ( auto i{ idle.begin() }; i != idle.end(); )
+        {
+            if ( now - i->second < std::chrono::seconds( idle_seconds ) )
+            {
+                ++i;
+                continue;
+            }
+
+            ::close( i->first );
+            i = idle.erase(i);
+            --open;
+        }
+    }
+}
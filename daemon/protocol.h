@@ -0,0 +1,222 @@
+//)binary protocol spoken over the parse daemon's Unix domain socket (see midid.cpp)
+//)every message is a fixed header followed by length bytes of payload; integers are in host byte order,
+//// since both ends are always on the same machine
+//)requests:
+//// parse_path  payload is an absolute file path (the daemon's working directory isn't the client's, so relative
+////             paths are refused as bad requests); the daemon reads and parses the file (cached by path, size and mtime)
+//// parse_bytes payload is the file itself (cached by content)
+//// get_stats   no payload
+//)parse responses hold, for the tables asked for in Request::tables:
+//// u32 division, u32 tracks, then per track:
+//// u32 notes, u32 meta events,
+//// notes as { i64 onset, i64 duration, u8 channel, u8 pitch, u8 velocity },
+//// meta events as { i64 tick, u8 type, f64 bpm, i32 first, i32 second, u32 text length, text },
+//// then, if the density table was asked for, u32 levels and per level:
+//// i64 ticks per bucket, u32 buckets, buckets as { u32 notes, u16 polyphony, u8 low, u8 high, u8 velocity }
+//)stats responses hold a Stats struct
+
+#pragma once
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//not every platform has MSG_NOSIGNAL; the programs ignore SIGPIPE as well
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+enum Op : std::uint8_t
+{
+    parse_path = 1,
+    parse_bytes = 2,
+    get_stats = 3
+};
+
+//bits of Request::tables
+constexpr std::uint8_t notes_table{ 0x01 };
+constexpr std::uint8_t meta_table{ 0x02 };
+constexpr std::uint8_t density_table{ 0x04 };
+
+//requests bigger than this are refused, so one client can't make the daemon buffer an arbitrary amount
+constexpr std::uint32_t max_request{ 64 * 1024 * 1024 };
+
+struct Request
+{
+    std::uint8_t op{};
+    std::uint8_t tables{ notes_table | meta_table };
+    std::uint16_t reserved{ 0 };
+    std::uint32_t length{ 0 };
+};
+
+enum Status : std::uint32_t
+{
+    status_ok = 0,
+    bad_request = 1,
+    unreadable = 2,
+    too_large = 3
+};
+
+struct Response
+{
+    std::uint32_t status{ status_ok };
+    std::uint32_t length{ 0 };
+};
+
+struct Stats
+{
+    std::uint64_t requests{};
+    std::uint64_t cache_hits{};
+    std::uint64_t cache_misses{};
+    std::uint64_t cached_files{};
+
+    //over the most recent requests, in microseconds from when the request was queued for a worker to its response
+    double p50{};
+    double p99{};
+};
+
+//read or write exactly size bytes, retrying after interrupts and short transfers;
+//returns false if the connection closed or failed
+
+inline bool readAll(int fd, void* data, std::size_t size)
+{
+    char* p{ static_cast<char*>(data) };
+
+    while ( size > 0 )
+    {
+        ssize_t n{ ::read(fd, p, size) };
+
+        if ( n < 0 && errno == EINTR )
+            continue;
+
+        if ( n <= 0 )
+            return false;
+
+        p += n;
+        size -= static_cast<std::size_t>(n);
+    }
+
+    return true;
+}
+
+inline bool writeAll(int fd, const void* data, std::size_t size)
+{
+    const char* p{ static_cast<const char*>(data) };
+
+    while ( size > 0 )
+    {
+        ssize_t n{ ::send(fd, p, size, MSG_NOSIGNAL) };
+
+        if ( n < 0 && errno == EINTR )
+            continue;
+
+        if ( n <= 0 )
+            return false;
+
+        p += n;
+        size -= static_cast<std::size_t>(n);
+    }
+
+    return true;
+}
+
+//append a value to a payload as raw bytes
+template <typename T>
+void put(std::vector<char>& out, const T& value)
+{
+    const char* p{ reinterpret_cast<const char*>(&value) };
+
+    out.insert( out.end(), p, p + sizeof(T) );
+}
+
+//read a value from a payload, advancing offset; returns false if the payload is too short
+template <typename T>
+bool get(const std::vector<char>& in, std::size_t& offset, T& value)
+{
+    if ( offset + sizeof(T) > std::size(in) )
+        return false;
+
+    std::memcpy( &value, in.data() + offset, sizeof(T) );
+    offset += sizeof(T);
+
+    return true;
+}
+
+//parse a count given on a command line (digits only) from 1 to most;
+//returns 0 if it can't be parsed or is out of range, so the programs can refuse it
+inline std::size_t parseCount(std::string_view s, std::size_t most)
+{
+    std::size_t n{ 0 };
+
+    for ( char c : s )
+    {
+        if ( c < '0' || c > '9' )
+            return 0;
+
+        n = n * 10 + (c - '0');
+
+        //stop before it can overflow
+        if ( n > most )
+            return 0;
+    }
+
+    return n;
+}
+
+//resolve a path given to a client into the absolute path the daemon needs; returns false if it doesn't exist
+inline bool absolutePath(const std::string& path, std::string& absolute)
+{
+    char resolved[PATH_MAX]{};
+
+    if ( !::realpath(path.c_str(), resolved) )
+        return false;
+
+    absolute = resolved;
+
+    return true;
+}
+
+//connect to the daemon; returns -1 on failure
+inline int connectTo(const std::string& socket_path)
+{
+    int fd{ ::socket(AF_UNIX, SOCK_STREAM, 0) };
+
+    if ( fd < 0 )
+        return -1;
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy( address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1 );
+
+    if ( ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 )
+    {
+        ::close(fd);
+
+        return -1;
+    }
+
+    return fd;
+}
+
+//send one request and wait for its response; returns false if the connection failed
+inline bool roundTrip(int fd, const Request& request, const void* payload, Response& response, std::vector<char>& body)
+{
+    if ( !writeAll(fd, &request, sizeof(request)) || !writeAll(fd, payload, request.length) )
+        return false;
+
+    if ( !readAll(fd, &response, sizeof(response)) )
+        return false;
+
+    body.resize( response.length );
+
+    return readAll(fd, body.data(), response.length);
+}
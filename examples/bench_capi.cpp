@@ -0,0 +1,128 @@
+//compare getting the notes of a batch of files through the C interface
+//against running the executable on each file and reading the notes back out of its text output
+//
+//    g++ -O2 bench_capi.cpp -L.. -lmidiparser -o bench_capi
+//    ./bench_capi ../main.exe file.mid ...
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../midi_capi.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+//how many times each file is read by each method
+constexpr int rounds{ 10 };
+
+//count notes through the C interface, touching every one of them
+long countLibrary(const std::vector<std::string>& filenames)
+{
+    long notes{ 0 };
+
+    for ( const auto& filename : filenames )
+    {
+        midi_file* file{ midi_open_file( filename.c_str() ) };
+
+        if ( !file )
+            continue;
+
+        for ( std::size_t t{ 0 }; t < midi_track_count(file); ++t )
+        {
+            std::size_t count{ 0 };
+            const midi_note* n{ midi_notes(file, t, &count) };
+
+            for ( std::size_t i{ 0 }; i < count; ++i )
+                notes += ( n[i].duration >= 0 );
+        }
+
+        midi_close(file);
+    }
+
+    return notes;
+}
+
+//count notes by running the executable and parsing the lines after every "MIDI Notes:"
+long countExecutable(const std::string& executable, const std::vector<std::string>& filenames)
+{
+    long notes{ 0 };
+
+    for ( const auto& filename : filenames )
+    {
+        std::string command{ '"' + executable + "\" \"" + filename + '"' };
+
+        std::FILE* pipe{ popen( command.c_str(), "r" ) };
+
+        if ( !pipe )
+            continue;
+
+        char line[256];
+        bool in_notes{ false };
+
+        while ( std::fgets(line, sizeof(line), pipe) )
+        {
+            std::string_view l{ line };
+
+            if ( l == "MIDI Notes:\n" )
+            {
+                in_notes = true;
+            }
+            //note lines are "pitch-octave rhythm", and nothing else in the output starts with a note name
+            else if ( in_notes && l.size() > 2 && l[0] >= 'A' && l[0] <= 'G' && l.find(' ') != l.npos && l.find(':') == l.npos )
+            {
+                ++notes;
+            }
+            else
+            {
+                in_notes = false;
+            }
+        }
+
+        pclose(pipe);
+    }
+
+    return notes;
+}
+
+template <typename F>
+double time(F f, long& result)
+{
+    auto start{ std::chrono::steady_clock::now() };
+
+    for ( int r{ 0 }; r < rounds; ++r )
+        result = f();
+
+    std::chrono::duration<double, std::milli> elapsed{ std::chrono::steady_clock::now() - start };
+
+    return elapsed.count() / rounds;
+}
+
+int main(int argc, char* argv[])
+{
+    if ( argc < 3 )
+    {
+        std::cerr << "usage: " << argv[0] << " <path to parser executable> file.mid ...\n";
+
+        return 1;
+    }
+
+    std::string executable{ argv[1] };
+    std::vector<std::string> filenames( argv + 2, argv + argc );
+
+    long library_notes{};
+    long executable_notes{};
+
+    double library_ms{ time( [&] { return countLibrary(filenames); }, library_notes ) };
+    double executable_ms{ time( [&] { return countExecutable(executable, filenames); }, executable_notes ) };
+
+    std::cout << "C interface: " << library_ms << " ms per batch (" << library_notes << " notes)\n";
+    std::cout << "Executable + text: " << executable_ms << " ms per batch (" << executable_notes << " notes)\n";
+    std::cout << "Speedup: " << executable_ms / library_ms << "x\n";
+
+    return 0;
+}
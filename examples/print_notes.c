@@ -0,0 +1,55 @@
+/*
+ * print the notes and text events of a MIDI file through the C interface
+ *
+ *     gcc -O2 print_notes.c -L.. -lmidiparser -o print_notes
+ */
+
+#include <stdio.h>
+
+#include "../midi_capi.h"
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s file.mid\n", argv[0]);
+        return 1;
+    }
+
+    midi_file* file = midi_open_file(argv[1]);
+
+    if (!file)
+    {
+        fprintf(stderr, "%s could not be read\n", argv[1]);
+        return 1;
+    }
+
+    printf("Ticks per quarter note: %d\n", midi_division(file));
+
+    for (size_t t = 0; t < midi_track_count(file); ++t)
+    {
+        size_t note_count = 0;
+        size_t meta_count = 0;
+
+        const midi_note* notes = midi_notes(file, t, &note_count);
+        const midi_meta* meta = midi_meta_events(file, t, &meta_count);
+
+        printf("\nTrack %zu: %zu notes, %zu meta events\n", t, note_count, meta_count);
+
+        for (size_t m = 0; m < meta_count; ++m)
+        {
+            if (meta[m].text)
+                printf("\t%lld: %.*s\n", (long long)meta[m].tick, (int)meta[m].length, meta[m].text);
+        }
+
+        for (size_t n = 0; n < note_count; ++n)
+        {
+            printf("\t%lld: channel %u, note %u, %lld ticks\n", (long long)notes[n].onset,
+                   notes[n].channel, notes[n].pitch, (long long)notes[n].duration);
+        }
+    }
+
+    midi_close(file);
+
+    return 0;
+}
@@ -2,42 +2,44 @@
 #include <bitset>
 #include <fstream>
 
-void printFormat(int c)
+#include "MIDIparser.h"
+
+void printFormat(int c, std::ostream& out)
 {
     if( c == 0 )
     {
-        std::cout << "Format: single multi-channel track\n";
+        out << "Format: single multi-channel track\n";
     }
     else if ( c == 1 )
     {
-        std::cout << "Format: one or more simultaneous tracks of a sequence\n";
+        out << "Format: one or more simultaneous tracks of a sequence\n";
     }
     else
     {
-        std::cout << "Format: one or more sequentially independent single-track patterns\n";
+        out << "Format: one or more sequentially independent single-track patterns\n";
     }
 }
 
-void printNumTracks(int c)
+void printNumTracks(int c, std::ostream& out)
 {
-    std::cout << "Number of tracks: " << c << '\n';
+    out << "Number of tracks: " << c << '\n';
 }
 
-void printDivision(short& division)
+void printDivision(short& division, std::ostream& out, std::ostream& err)
 {
     //test if MSB is 0 (metrical time) or 1 (time-code-based time); will currently not convert from time-code-based time
-    if( division & 0x80 )
+    if( division & 0x8000 )
     {
-        std::cerr << "Error: cannot convert from time-code-based time\n";
+        err << "Error: cannot convert from time-code-based time\n";
     }
     else
     {
         //bits 14-0 represent number of delta time ticks that make up a quarter note
-        std::cout << "Ticks per quarter note: " << division << '\n';
+        out << "Ticks per quarter note: " << division << '\n';
     }
 }
 
-short parseMIDIHeader(std::ifstream& inf)
+short parseMIDIHeader(std::istream& inf, std::ostream& out, std::ostream& err)
 {
     char c{};
 
@@ -53,12 +55,12 @@ short parseMIDIHeader(std::ifstream& inf)
         if (traverse == 9)
         {
             //skip first byte of <format> since the latter will always be 0, 1, or 2
-            printFormat(c);
+            printFormat(c, out);
         }
         else if ( traverse == 11 )
         {
             //skip first byte since highly doubtful that there will be more than 127 tracks (a <format> of 0 will always be 1)
-            printNumTracks(c);
+            printNumTracks(c, out);
         }
         else if ( traverse == 12 )
         {
@@ -68,8 +70,9 @@ short parseMIDIHeader(std::ifstream& inf)
         else if ( traverse > 12 )
         {
             //assign to least significant half of the 16-bit division variable
-            division |= c;
-            printDivision(division);
+            //(as an unsigned byte, or a division like 480 would sign-extend into a negative one)
+            division |= static_cast<unsigned char>(c);
+            printDivision(division, out, err);
             break;
         }
         ++traverse;
@@ -1,31 +1,699 @@
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
 
-short parseMIDIHeader(std::ifstream& inf);
+#include "MIDIparser.h"
+#include "Fingerprint.h"
+#include "Analytics.h"
+#include "PianoRoll.h"
+#include "ControlLanes.h"
+#include "DensityPyramid.h"
+#include "NoteTransform.h"
+#include "MetaTable.h"
 
-void parseTracks(std::ifstream& inf, short quarter_note);
+//files whose sketches agree on at least this fraction of slots are reported as near-duplicates
+constexpr double duplicate_threshold{ 0.8 };
 
-int main()
+//widest piano-roll frame --roll-frame can ask for, in ticks
+constexpr long max_frame_ticks{ 1L << 30 };
+
+//most threads --jobs and --segments can ask for
+constexpr std::size_t max_threads{ 256 };
+
+//parse a plain count (no size suffixes) from 1 to most; returns 0 if it can't be parsed or is out of range
+std::size_t parseCount(std::string_view s, std::size_t most)
+{
+    std::size_t n{ 0 };
+
+    for ( char c : s )
+    {
+        if ( c < '0' || c > '9' )
+            return 0;
+
+        n = n * 10 + (c - '0');
+
+        //stop before it can overflow
+        if ( n > most )
+            return 0;
+    }
+
+    return n;
+}
+
+//parse a size like 512k or 64m into bytes; returns 0 if it can't be parsed
+std::size_t parseSize(std::string_view s)
 {
-    std::string filename{ "midi/eyelash.mid" };
+    std::size_t scale{ 1 };
+
+    if ( !s.empty() && (s.back() == 'k' || s.back() == 'K') )
+        scale = 1024;
+    else if ( !s.empty() && (s.back() == 'm' || s.back() == 'M') )
+        scale = 1024 * 1024;
+
+    if ( scale > 1 )
+        s.remove_suffix(1);
 
-    std::ifstream inf{ filename };
+    std::size_t bytes{ 0 };
+
+    for ( char c : s )
+    {
+        if ( c < '0' || c > '9' )
+            return 0;
+
+        bytes = bytes * 10 + (c - '0');
+    }
+
+    return bytes * scale;
+}
+
+//parse one file of the batch, handing its notes and meta events to the listeners in options;
+//if memory_limit isn't 0, the file is parsed in bounded-memory mode and its peak usage is reported
+bool parseFile(const std::string& filename, ParseOptions options, std::size_t memory_limit)
+{
+    std::ifstream inf{ filename, std::ios::binary };
 
     if(!inf)
     {
         std::cerr << filename << " could not be opened for reading\n";
 
-        return -1;
+        return false;
     }
 
-    std::cout << "\nReading MIDI file: " << filename << "\n\n";
+    //every byte matters; don't let >> skip bytes that happen to look like whitespace
+    inf >> std::noskipws;
+
+    *options.out << "\nReading MIDI file: " << filename << "\n\n";
+
+    short quarter_note{ parseMIDIHeader(inf, *options.out, *options.err) };
+
+    *options.out << '\n';
+
+    MemoryMeter meter{ memory_limit };
+
+    if ( memory_limit > 0 )
+        options.memory = &meter;
+
+    bool parsed{ parseTracks(inf, quarter_note, options) };
+
+    if ( options.memory )
+    {
+        //report on cerr so it isn't silenced in index mode
+        std::cerr << filename << ": peak memory " << meter.peak() << " bytes (limit " << meter.limit() << ")\n";
+    }
+
+    return parsed;
+}
+
+//parse the whole batch on jobs threads, each with its own Analytics, then merge them and print the summary;
+//returns false if any file couldn't be parsed
+bool runAnalytics(const std::vector<std::string>& filenames, unsigned jobs, std::size_t memory_limit, bool sustain,
+                  std::size_t segments)
+{
+    std::vector<Analytics> totals( jobs );
+    std::atomic<std::size_t> next{ 0 };
+    std::atomic<bool> ok{ true };
+
+    auto worker{ [&](Analytics& analytics)
+    {
+        //nothing is printed per file; every worker gets its own stream without a buffer
+        std::ostream silent{ nullptr };
+
+        ParseOptions options{};
+        options.listeners.push_back( &analytics );
+        options.meta_listeners.push_back( &analytics );
+        options.out = &silent;
+        options.sustain = sustain;
+        options.segments = segments;
+
+        //workers take the next unparsed file until there are none left
+        for ( std::size_t i{ next++ }; i < std::size(filenames); i = next++ )
+        {
+            if ( !parseFile(filenames[i], options, memory_limit) )
+                ok = false;
+        }
+    } };
+
+    std::vector<std::thread> threads{};
+
+    for ( unsigned t{ 1 }; t < jobs; ++t )
+        threads.emplace_back( worker, std::ref(totals[t]) );
+
+    worker( totals[0] );
+
+    for ( auto& t : threads )
+        t.join();
+
+    for ( unsigned t{ 1 }; t < jobs; ++t )
+        totals[0].merge( totals[t] );
+
+    std::cout << totals[0];
+
+    return ok;
+}
+
+//parse a piano-roll frame width: a whole number of ticks (1 to max_frame_ticks), or a number of seconds followed by s
+//(like 0.01s); returns false if it can't be parsed
+bool parseFrame(std::string_view s, RollOptions& options)
+{
+    bool seconds{ !s.empty() && s.back() == 's' };
+
+    if ( seconds )
+        s.remove_suffix(1);
+
+    std::string number{ s };
+    char* end{ nullptr };
+
+    if ( number.empty() )
+        return false;
+
+    if ( seconds )
+    {
+        double value{ std::strtod( number.c_str(), &end ) };
+
+        if ( *end != '\0' || !std::isfinite(value) || value <= 0.0 )
+            return false;
+
+        options.frame_seconds = value;
+        options.frame_ticks = 0;
+
+        return true;
+    }
+
+    //ticks are whole numbers, so 1.5 is refused rather than cut down to 1
+    long value{ std::strtol( number.c_str(), &end, 10 ) };
+
+    if ( *end != '\0' || value < 1 || value > max_frame_ticks )
+        return false;
+
+    options.frame_ticks = value;
+
+    return true;
+}
+
+//parse the steps of a transform, separated by commas: transpose:<semitones>, velocity:<factor>, stretch:<factor>,
+//quantize:<grid lines per quarter note>, channel:<from>:<to>; factors are finite, above 0 and at most
+//NoteTransform::max_velocity_scale or max_stretch; returns false if it can't be parsed
+bool parseTransform(std::string_view s, NoteTransform& transform)
+{
+    while ( !s.empty() )
+    {
+        std::string_view step{ s.substr( 0, s.find(',') ) };
+        s.remove_prefix( std::min( std::size(step) + 1, std::size(s) ) );
+
+        std::size_t colon{ step.find(':') };
+
+        if ( colon == std::string_view::npos )
+            return false;
+
+        std::string_view name{ step.substr(0, colon) };
+        std::string number{ step.substr(colon + 1) };
+        char* end{ nullptr };
+
+        if ( name == "channel" )
+        {
+            long from{ std::strtol( number.c_str(), &end, 10 ) };
+
+            if ( *end != ':' || from < 0 || from > 15 )
+                return false;
+
+            long to{ std::strtol( end + 1, &end, 10 ) };
+
+            if ( *end != '\0' || to < 0 || to > 15 )
+                return false;
+
+            transform.channels[from] = static_cast<int>(to);
+
+            continue;
+        }
+
+        //semitones and grid lines are whole numbers, so 1.5 is refused rather than cut down to 1
+        if ( name == "transpose" || name == "quantize" )
+        {
+            long value{ std::strtol( number.c_str(), &end, 10 ) };
+
+            if ( number.empty() || *end != '\0' || value < -1000 || value > 1000 )
+                return false;
+
+            if ( name == "transpose" )
+                transform.transpose = static_cast<int>(value);
+            else if ( value >= 1 )
+                transform.quantize = static_cast<int>(value);
+            else
+                return false;
+
+            continue;
+        }
+
+        double value{ std::strtod( number.c_str(), &end ) };
+
+        //factors past the largest a transform takes (and inf or nan) would overflow the conversions back to integers
+        if ( number.empty() || *end != '\0' || !std::isfinite(value) || value <= 0.0 )
+            return false;
+
+        if ( name == "velocity" && value <= NoteTransform::max_velocity_scale )
+            transform.velocity_scale = value;
+        else if ( name == "stretch" && value <= NoteTransform::max_stretch )
+            transform.stretch = value;
+        else
+            return false;
+    }
+
+    return true;
+}
+
+//the meta events --meta prints: every type if type is -1, otherwise only that type from first to last tick
+//(0 is a type of its own: sequence numbers)
+struct MetaQuery
+{
+    int type{ -1 };
+    long first{ 0 };
+    long last{ LONG_MAX };
+};
+
+//parse <type>[:<first tick>-<last tick>], where type is the byte after FF in decimal (5 for lyrics);
+//returns false if it can't be parsed
+bool parseMetaQuery(std::string_view s, MetaQuery& query)
+{
+    std::string spec{ s };
+    char* end{ nullptr };
+
+    long type{ std::strtol( spec.c_str(), &end, 10 ) };
+
+    if ( end == spec.c_str() || type < 0 || type > 0x7F )
+        return false;
+
+    query.type = static_cast<int>(type);
+
+    if ( *end == '\0' )
+        return true;
+
+    if ( *end != ':' )
+        return false;
+
+    query.first = std::strtol( end + 1, &end, 10 );
+
+    if ( *end != '-' )
+        return false;
 
-    short quarter_note{ parseMIDIHeader(inf) };
+    query.last = std::strtol( end + 1, &end, 10 );
 
-    std::cout << '\n';
+    return ( *end == '\0' && query.first <= query.last );
+}
 
-    parseTracks(inf, quarter_note);
+//usage: main [--fingerprint] [--index] [--analytics] [--jobs=<n>] [--max-memory=<size>]
+//            [--roll] [--roll-frame=<ticks>|<seconds>s] [--roll-onsets] [--roll-offsets] [--roll-packed]
+//            [--controllers] [--density] [--meta[=<query>]] [--sustain] [--segments=<n>] [--transform=<steps>]... [file ...]
+//--fingerprint prints each file's note fingerprint after its notes;
+//--index only fingerprints the files and then lists clusters of duplicates; nothing else is printed,
+//not even what --controllers, --density, --meta or --transform would print (--roll's files are still written);
+//--analytics parses the files on --jobs threads (default: one per core) and only prints corpus statistics;
+//--max-memory parses in bounded-memory mode, failing any file with a track whose input and sounding notes need more
+//than <size> bytes (what --roll, --meta, --controllers etc. keep for the whole file isn't counted);
+//a long-held note that keeps the notes after it from fitting is listed tied early, with a warning on stderr;
+//--roll writes each file's piano roll to <file>.npy (see PianoRoll.h), a sixteenth note per frame unless --roll-frame is given
+//(--roll-packed also writes its frame count to <file>.npy.json);
+//--controllers prints a summary of each file's controller, program, pressure and pitch bend lanes;
+//--density prints a summary of each level of each file's note density pyramid (see DensityPyramid.h);
+//--meta prints each file's meta events from its MetaTable (see MetaTable.h), or only those matching the query
+//(see parseMetaQuery), and how many distinct strings the batch interned;
+//--sustain extends notes held by the sustain pedal (for every output, including fingerprints and piano rolls);
+//--transform makes a variant of each file from its decoded notes (see parseTransform), once per --transform,
+//lists its notes after the file's, and gives it the same fingerprint, density and piano roll (<file>.<variant>.npy)
+//outputs as the file;
+//--segments decodes each large track in up to <n> segments at once (see ParseOptions::segments), with the same output;
+//it only applies with --index or --analytics, since the listing, --sustain and --max-memory need each track decoded in one go
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> filenames{};
+
+    bool fingerprint{ false };
+    bool index{ false };
+
+    bool analytics{ false };
+    unsigned jobs{ std::max( std::thread::hardware_concurrency(), 1u ) };
+
+    std::size_t memory_limit{ 0 };
+
+    bool roll{ false };
+    RollOptions roll_options{};
+
+    bool controllers{ false };
+    bool density{ false };
+    bool sustain{ false };
+
+    bool meta{ false };
+    MetaQuery meta_query{};
+
+    std::size_t segments{ 1 };
+
+    std::vector<std::string_view> transform_specs{};
+    std::vector<NoteTransform> transforms{};
+
+    for ( int arg{ 1 }; arg < argc; ++arg )
+    {
+        std::string_view a{ argv[arg] };
+
+        if ( a == "--fingerprint" )
+        {
+            fingerprint = true;
+        }
+        else if ( a == "--index" )
+        {
+            fingerprint = true;
+            index = true;
+        }
+        else if ( a == "--analytics" )
+        {
+            analytics = true;
+        }
+        else if ( a.substr(0, 7) == "--jobs=" )
+        {
+            jobs = static_cast<unsigned>( parseCount( a.substr(7), max_threads ) );
+
+            if ( jobs == 0 )
+            {
+                std::cerr << "Invalid number of jobs (1-" << max_threads << "): " << a.substr(7) << '\n';
+
+                return -1;
+            }
+        }
+        else if ( a.substr(0, 13) == "--max-memory=" )
+        {
+            memory_limit = parseSize( a.substr(13) );
+
+            if ( memory_limit == 0 )
+            {
+                std::cerr << "Invalid memory limit: " << a.substr(13) << '\n';
+
+                return -1;
+            }
+        }
+        else if ( a == "--controllers" )
+        {
+            controllers = true;
+        }
+        else if ( a == "--density" )
+        {
+            density = true;
+        }
+        else if ( a == "--meta" )
+        {
+            meta = true;
+        }
+        else if ( a.substr(0, 7) == "--meta=" )
+        {
+            if ( !parseMetaQuery( a.substr(7), meta_query ) )
+            {
+                std::cerr << "Invalid meta query: " << a.substr(7) << '\n';
+
+                return -1;
+            }
+
+            meta = true;
+        }
+        else if ( a == "--sustain" )
+        {
+            sustain = true;
+        }
+        else if ( a.substr(0, 11) == "--segments=" )
+        {
+            segments = parseCount( a.substr(11), max_threads );
+
+            if ( segments == 0 )
+            {
+                std::cerr << "Invalid number of segments (1-" << max_threads << "): " << a.substr(11) << '\n';
+
+                return -1;
+            }
+        }
+        else if ( a.substr(0, 12) == "--transform=" )
+        {
+            NoteTransform transform{};
+
+            if ( !parseTransform( a.substr(12), transform ) )
+            {
+                std::cerr << "Invalid transform: " << a.substr(12) << '\n';
+
+                return -1;
+            }
+
+            transform_specs.push_back( a.substr(12) );
+            transforms.push_back( transform );
+        }
+        else if ( a == "--roll" )
+        {
+            roll = true;
+        }
+        else if ( a.substr(0, 13) == "--roll-frame=" )
+        {
+            if ( !parseFrame( a.substr(13), roll_options ) )
+            {
+                std::cerr << "Invalid frame width: " << a.substr(13) << '\n';
+
+                return -1;
+            }
+        }
+        else if ( a == "--roll-onsets" )
+        {
+            roll_options.onsets = true;
+        }
+        else if ( a == "--roll-offsets" )
+        {
+            roll_options.offsets = true;
+        }
+        else if ( a == "--roll-packed" )
+        {
+            roll_options.packed = true;
+        }
+        else
+        {
+            filenames.emplace_back( a );
+        }
+    }
+
+    if ( filenames.empty() )
+    {
+        filenames.emplace_back( "midi/eyelash.mid" );
+    }
+
+    if ( analytics )
+    {
+        return runAnalytics(filenames, jobs, memory_limit, sustain, segments) ? 0 : -1;
+    }
+
+    std::vector<Fingerprint> prints{};
+    std::vector<std::string> printed{};
+
+    int result{ 0 };
+
+    //in index mode, the per-file output (and everything else but the clusters) goes to a stream without a buffer,
+    //which skips all formatting
+    std::ostream silent{ nullptr };
+    std::ostream& out{ index ? silent : std::cout };
+
+    //the text of every file's meta events, so strings repeated across the batch are kept once
+    StringPool strings{};
+
+    for ( const auto& filename : filenames )
+    {
+        Fingerprint f{};
+        PianoRoll pianoRoll{ roll_options };
+        ControlLanes lanes{};
+        DensityPyramid pyramid{};
+        NoteColumns columns{};
+        MetaTable metaTable{ strings };
+
+        ParseOptions options{};
+        options.sustain = sustain;
+        options.segments = segments;
+
+        options.out = &out;
+
+        if ( fingerprint )
+            options.listeners.push_back( &f );
+
+        if ( controllers )
+            options.control_listeners.push_back( &lanes );
+
+        if ( density )
+            options.listeners.push_back( &pyramid );
+
+        if ( meta )
+        {
+            options.listeners.push_back( &metaTable );
+            options.meta_listeners.push_back( &metaTable );
+        }
+
+        //every variant is made from the same decoded notes, so the file is only decoded once
+        if ( !transforms.empty() )
+        {
+            options.listeners.push_back( &columns );
+            options.meta_listeners.push_back( &columns );
+        }
+
+        if ( roll )
+        {
+            options.listeners.push_back( &pianoRoll );
+            options.meta_listeners.push_back( &pianoRoll );
+        }
+
+        bool parsed{ parseFile(filename, options, memory_limit) };
+
+        if ( !parsed )
+        {
+            result = -1;
+
+            continue;
+        }
+
+        if ( controllers )
+        {
+            lanes.shrink();
+
+            out << "Controllers:\n" << lanes << '\n';
+        }
+
+        if ( density )
+        {
+            pyramid.finish();
+
+            out << "Note density:\n" << pyramid << '\n';
+        }
+
+        if ( meta )
+        {
+            metaTable.finish();
+
+            out << "Meta events:\n";
+
+            if ( meta_query.type < 0 )
+            {
+                out << metaTable;
+            }
+            else
+            {
+                for ( const MetaEvent* e : metaTable.find( meta_query.type, meta_query.first, meta_query.last ) )
+                    out << *e << '\n';
+            }
+
+            out << '\n';
+        }
+
+        if ( fingerprint )
+        {
+            out << "Fingerprint: " << f << "\n\n";
+
+            prints.push_back( f );
+            printed.push_back( filename );
+        }
+
+        if ( roll && !pianoRoll.write( filename + ".npy" ) )
+        {
+            std::cerr << filename << ".npy: " << pianoRoll.error() << '\n';
+
+            result = -1;
+        }
+
+        for ( std::size_t v{ 0 }; v < std::size(transforms); ++v )
+        {
+            NoteColumns variant{ columns };
+            variant.apply( transforms[v] );
+
+            Fingerprint variant_print{};
+            PianoRoll variant_roll{ roll_options };
+            DensityPyramid variant_pyramid{};
+
+            std::vector<NoteListener*> listeners{};
+            std::vector<MetaListener*> meta_listeners{};
+
+            if ( fingerprint )
+                listeners.push_back( &variant_print );
+
+            if ( density )
+                listeners.push_back( &variant_pyramid );
+
+            if ( roll )
+            {
+                listeners.push_back( &variant_roll );
+                meta_listeners.push_back( &variant_roll );
+            }
+
+            variant.replay( listeners, meta_listeners );
+
+            std::string name{ filename + '.' + std::to_string(v + 1) };
+
+            //listed like the file's own notes
+            out << "Variant " << v + 1 << " (" << transform_specs[v] << "): " << std::size(variant) << " notes\n";
+            variant.print( out );
+            out << '\n';
+
+            if ( density )
+            {
+                variant_pyramid.finish();
+
+                out << "Note density:\n" << variant_pyramid << '\n';
+            }
+
+            if ( fingerprint )
+            {
+                out << "Fingerprint: " << variant_print << "\n\n";
+
+                prints.push_back( variant_print );
+                printed.push_back( name );
+            }
+
+            if ( roll && !variant_roll.write( name + ".npy" ) )
+            {
+                std::cerr << name << ".npy: " << variant_roll.error() << '\n';
+
+                result = -1;
+            }
+        }
+    }
+
+    if ( meta )
+    {
+        out << "Interned strings: " << std::size(strings) << " distinct, " << strings.bytes() << " bytes\n";
+    }
+
+    if ( index )
+    {
+        auto clusters{ clusterFingerprints(prints, duplicate_threshold) };
+
+        std::cout << "\nDuplicate clusters: " << std::size(clusters) << '\n';
+
+        for ( std::size_t c{ 0 }; c < std::size(clusters); ++c )
+        {
+            std::cout << "\nCluster " << c + 1 << ":\n";
+
+            //compare every member to the first one in the cluster
+            const auto& first{ prints[ clusters[c].front() ] };
+
+            for ( auto i : clusters[c] )
+            {
+                std::cout << '\t' << printed[i];
+
+                if ( &prints[i] != &first )
+                {
+                    if ( prints[i].hash() == first.hash() )
+                        std::cout << " (exact)";
+                    else
+                        std::cout << " (" << prints[i].similarity( first ) * 100 << "% similar)";
+                }
+
+                std::cout << '\n';
+            }
+        }
+    }
 
-	return 0;
-}
\ No newline at end of file
+	return result;
+}
@@ -0,0 +1,280 @@
+//implementation of the C interface in midi_capi.h;
+//a midi_file listens to the parser like Fingerprint and Analytics do, and keeps what it hears in flat tables
+
+#define MIDI_BUILDING_LIBRARY
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "midi_capi.h"
+#include "DensityPyramid.h"
+#include "MIDInotes.h"
+#include "MIDIparser.h"
+#include "MetaTable.h"
+
+struct midi_file : public NoteListener, public MetaListener
+{
+    short division{};
+
+    //notes and meta events of every track, one track after another;
+    //the tracks vectors hold the index of the first note/event of each track
+    std::vector<midi_note> notes{};
+    std::vector<std::size_t> note_tracks{};
+
+    std::vector<midi_meta> meta{};
+    std::vector<std::size_t> meta_tracks{};
+
+    //text of the text events, each distinct string once; it never moves, so the text pointers are set as they arrive
+    StringPool text{};
+
+    //diagnostics printed while decoding
+    std::string errors{};
+
+    //listens to the notes alongside the file; its levels are copied into density once it is built
+    DensityPyramid pyramid{};
+    std::vector<std::vector<midi_density_bucket>> density{};
+
+    void trackStarted() override
+    {
+        note_tracks.push_back( std::size(notes) );
+        meta_tracks.push_back( std::size(meta) );
+    }
+
+    void noteFinished(const MIDInote& note) override
+    {
+        notes.push_back( midi_note{ note.onset(), note.duration(),
+                                    static_cast<std::uint8_t>( note.channel() ),
+                                    static_cast<std::uint8_t>( note.getPitch().MIDInote() ),
+                                    static_cast<std::uint8_t>( note.velocity() ) } );
+    }
+
+    void tempoChange(long tick, double bpm) override
+    {
+        meta.push_back( midi_meta{ tick, 0x51, nullptr, 0, bpm, 0, 0 } );
+    }
+
+    void timeSignature(long tick, int numerator, int denominator) override
+    {
+        meta.push_back( midi_meta{ tick, 0x58, nullptr, 0, 0.0, numerator, denominator } );
+    }
+
+    void keySignature(long tick, int sharps, bool minor) override
+    {
+        meta.push_back( midi_meta{ tick, 0x59, nullptr, 0, 0.0, sharps, minor } );
+    }
+
+    void textEvent(long tick, int type, std::string_view t) override
+    {
+        std::string_view interned{ text.intern(t) };
+
+        meta.push_back( midi_meta{ tick, static_cast<std::uint8_t>(type), interned.data(), std::size(interned), 0.0, 0, 0 } );
+    }
+
+    //order each track's notes by onset
+    //(they arrive in the order they were turned off), and build the density pyramid
+    void finish();
+
+    std::size_t tracks() const { return std::size(note_tracks); }
+};
+
+void midi_file::finish()
+{
+    for ( std::size_t track{ 0 }; track < tracks(); ++track )
+    {
+        auto begin{ notes.begin() + note_tracks[track] };
+        auto end{ track + 1 < tracks() ? notes.begin() + note_tracks[track + 1] : notes.end() };
+
+        std::stable_sort( begin, end, [](const midi_note& a, const midi_note& b) { return a.onset < b.onset; } );
+    }
+
+    pyramid.finish();
+
+    for ( std::size_t l{ 0 }; l < pyramid.levels(); ++l )
+    {
+        std::vector<midi_density_bucket>& level{ density.emplace_back() };
+
+        for ( const auto& b : pyramid.level(l) )
+            level.push_back( midi_density_bucket{ b.notes, b.polyphony, b.low, b.high, b.velocity } );
+    }
+}
+
+//create streambuf to read from a block of memory without copying it
+
+class MemoryBuffer : public std::streambuf
+{
+public:
+    MemoryBuffer(const char* data, std::size_t size)
+    {
+        char* begin{ const_cast<char*>(data) };
+
+        setg( begin, begin, begin + size );
+    }
+};
+
+//decode everything in the stream into a new midi_file, large tracks in up to segments parts at once;
+//nothing is printed, and diagnostics are kept in the file
+midi_file* decode(std::istream& in, std::size_t segments)
+{
+    try
+    {
+        auto file{ std::make_unique<midi_file>() };
+
+        std::ostream silent{ nullptr };
+        std::ostringstream errors{};
+
+        ParseOptions options{};
+        options.listeners.push_back( file.get() );
+        options.listeners.push_back( &file->pyramid );
+        options.meta_listeners.push_back( file.get() );
+        options.out = &silent;
+        options.err = &errors;
+        options.segments = std::max( segments, std::size_t{ 1 } );
+
+        in >> std::noskipws;
+
+        file->division = parseMIDIHeader(in, silent, errors);
+
+        if ( !in )
+            return nullptr;
+
+        parseTracks(in, file->division, options);
+
+        file->finish();
+        file->errors = errors.str();
+
+        return file.release();
+    }
+    //exceptions can't cross into C
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+//return the range [first, last) of a track in one of the tables
+template <typename T>
+const T* trackRange(const std::vector<T>& table, const std::vector<std::size_t>& starts, std::size_t track, std::size_t* count)
+{
+    std::size_t first{ starts[track] };
+    std::size_t last{ track + 1 < std::size(starts) ? starts[track + 1] : std::size(table) };
+
+    if ( count )
+        *count = last - first;
+
+    return ( first < last ) ? table.data() + first : nullptr;
+}
+
+extern "C" {
+
+int midi_abi_version(void)
+{
+    return MIDI_ABI_VERSION;
+}
+
+midi_file* midi_open_file(const char* path)
+{
+    return midi_open_file_ex(path, 1);
+}
+
+midi_file* midi_open_memory(const void* data, size_t size)
+{
+    return midi_open_memory_ex(data, size, 1);
+}
+
+midi_file* midi_open_file_ex(const char* path, size_t segments)
+{
+    if ( !path )
+        return nullptr;
+
+    std::ifstream inf{ path, std::ios::binary };
+
+    if ( !inf )
+        return nullptr;
+
+    return decode(inf, segments);
+}
+
+midi_file* midi_open_memory_ex(const void* data, size_t size, size_t segments)
+{
+    if ( !data )
+        return nullptr;
+
+    MemoryBuffer buffer{ static_cast<const char*>(data), size };
+    std::istream in{ &buffer };
+
+    return decode(in, segments);
+}
+
+void midi_close(midi_file* file)
+{
+    delete file;
+}
+
+const char* midi_errors(const midi_file* file)
+{
+    return file ? file->errors.c_str() : "";
+}
+
+int midi_division(const midi_file* file)
+{
+    return file ? file->division : 0;
+}
+
+size_t midi_track_count(const midi_file* file)
+{
+    return file ? file->tracks() : 0;
+}
+
+const midi_note* midi_notes(const midi_file* file, size_t track, size_t* count)
+{
+    if ( count )
+        *count = 0;
+
+    if ( !file || track >= file->tracks() )
+        return nullptr;
+
+    return trackRange(file->notes, file->note_tracks, track, count);
+}
+
+const midi_meta* midi_meta_events(const midi_file* file, size_t track, size_t* count)
+{
+    if ( count )
+        *count = 0;
+
+    if ( !file || track >= file->tracks() )
+        return nullptr;
+
+    return trackRange(file->meta, file->meta_tracks, track, count);
+}
+
+size_t midi_density_levels(const midi_file* file)
+{
+    return file ? std::size( file->density ) : 0;
+}
+
+const midi_density_bucket* midi_density(const midi_file* file, size_t level, size_t* count, int64_t* bucket_ticks)
+{
+    if ( count )
+        *count = 0;
+
+    if ( !file || level >= std::size( file->density ) )
+        return nullptr;
+
+    if ( count )
+        *count = std::size( file->density[level] );
+
+    if ( bucket_ticks )
+        *bucket_ticks = file->pyramid.bucketTicks(level);
+
+    return file->density[level].data();
+}
+
+}
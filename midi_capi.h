@@ -0,0 +1,123 @@
+/*
+ * C interface to the MIDI parser, for programs that would otherwise run the executable and read its output
+ *
+ * build as a shared library from header.cpp, tracks.cpp and midi_capi.cpp, e.g.
+ *     g++ -O2 -shared -fPIC -pthread header.cpp tracks.cpp midi_capi.cpp -o libmidiparser.so
+ *     g++ -O2 -shared header.cpp tracks.cpp midi_capi.cpp -o midiparser.dll
+ *
+ * a file is decoded completely by midi_open_file() / midi_open_memory();
+ * after that, a handle is never modified until midi_close(), so any number of threads can read from it at once,
+ * and separate handles can be opened and read on separate threads without any locking
+ *
+ * every pointer returned points into storage owned by the handle, and stays valid until midi_close()
+ *
+ * MIDI_ABI_VERSION goes up whenever a struct or function changes; a program built against one version should check
+ * that midi_abi_version() returns the same before using the library
+ */
+
+#ifndef MIDI_CAPI_H
+#define MIDI_CAPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(MIDI_BUILDING_LIBRARY)
+#define MIDI_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define MIDI_API __declspec(dllimport)
+#else
+#define MIDI_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 2: midi_note.velocity, midi_errors(); 3: midi_open_file_ex(), midi_open_memory_ex() */
+#define MIDI_ABI_VERSION 3
+
+typedef struct midi_file midi_file;
+
+/* a note, from the moment it was turned on until it was turned off (or the track ended) */
+typedef struct midi_note
+{
+    int64_t onset;      /* ticks from the start of the track */
+    int64_t duration;   /* ticks */
+    uint8_t channel;    /* 0-15 */
+    uint8_t pitch;      /* MIDI note number */
+    uint8_t velocity;   /* 1-127 */
+} midi_note;
+
+/* values of the meta events the parser understands; type is the byte after FF */
+typedef struct midi_meta
+{
+    int64_t tick;
+    uint8_t type;
+
+    /* text events (01-07) and sequencer-specific events (7F): not NUL-terminated */
+    const char* text;
+    size_t length;
+
+    /* set tempo (51) */
+    double bpm;
+
+    /* time signature (58): numerator / denominator; key signature (59): sharps (negative for flats) / minor */
+    int32_t first;
+    int32_t second;
+} midi_meta;
+
+/* a bucket of one level of the file's note density pyramid (all tracks together) */
+typedef struct midi_density_bucket
+{
+    uint32_t notes;     /* notes that start in the bucket */
+    uint16_t polyphony; /* most notes sounding at once, at any tick of the bucket */
+    uint8_t low;        /* pitch range of the notes that start in the bucket */
+    uint8_t high;
+    uint8_t velocity;   /* loudest velocity of the notes that start in the bucket */
+} midi_density_bucket;
+
+/* the MIDI_ABI_VERSION the library was built with */
+MIDI_API int midi_abi_version(void);
+
+/* returns NULL if the file can't be read */
+MIDI_API midi_file* midi_open_file(const char* path);
+
+/* data is only read during the call, and can be freed as soon as it returns */
+MIDI_API midi_file* midi_open_memory(const void* data, size_t size);
+
+/* the same, but a large track (a format 0 file's only one, say) is decoded in up to segments parts at once,
+   on threads of their own; the handle holds the same as when segments is 0 or 1 */
+MIDI_API midi_file* midi_open_file_ex(const char* path, size_t segments);
+
+MIDI_API midi_file* midi_open_memory_ex(const void* data, size_t size, size_t segments);
+
+MIDI_API void midi_close(midi_file* file);
+
+/* what the parser complained about while decoding the file (unknown meta events, etc.), one message after another;
+   an empty string if nothing */
+MIDI_API const char* midi_errors(const midi_file* file);
+
+/* ticks per quarter note */
+MIDI_API int midi_division(const midi_file* file);
+
+MIDI_API size_t midi_track_count(const midi_file* file);
+
+/* the notes of a track, ordered by onset; returns NULL (and a count of 0) for an empty or missing track */
+MIDI_API const midi_note* midi_notes(const midi_file* file, size_t track, size_t* count);
+
+/* the meta events of a track, in the order they occur */
+MIDI_API const midi_meta* midi_meta_events(const midi_file* file, size_t track, size_t* count);
+
+/* levels of the note density pyramid: level 0 has the narrowest buckets, every level after it has buckets
+   twice as wide, and the last level is a single bucket for the whole file */
+MIDI_API size_t midi_density_levels(const midi_file* file);
+
+/* the buckets of a level, starting at tick 0; bucket_ticks (if not NULL) is set to the width of the level's buckets,
+   so the buckets showing ticks [a, b) are a / bucket_ticks through (b - 1) / bucket_ticks */
+MIDI_API const midi_density_bucket* midi_density(const midi_file* file, size_t level, size_t* count, int64_t* bucket_ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
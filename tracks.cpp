@@ -5,14 +5,20 @@
 //for MIDI events, I think (for now, at least) it's only
 //necessary to register Note Off and On events
 
+#include <algorithm>
+#include <string>
 #include <string_view>
 #include <vector>
 #include <fstream>
 #include <iostream>
 #include <bitset>
 #include <cstdint>
+#include <thread>
 
 #include "MIDInotes.h"
+#include "MIDIparser.h"
+#include "MetaTable.h"
+#include "TrackBuffer.h"
 
 enum Meta
 {
@@ -49,63 +55,6 @@ bool operator< (const Meta& m, const int& x)
     return ( x > m );
 }
 
-std::ostream& operator<< (std::ostream& out, Meta& m)
-{
-    switch(m)
-    {
-    case seq_num:
-        out << "Sequence Number";
-        break;
-    case text:
-        out << "Text";
-        break;
-    case copyright:
-        out << "Copyright Notice";
-        break;
-    case name:
-        out << "Sequence/Track Name";
-        break;
-    case instrument:
-        out << "Instrument";
-        break;
-    case lyrics:
-        out << "Lyrics";
-        break;    
-    case marker:
-        out << "Marker";
-        break;    
-    case cue:
-        out << "Cue Point";
-        break;    
-    case channel:
-        out << "MIDI Channel";
-        break;    
-    case end:
-        out << "End of Track";
-        break;    
-    case set_tempo:
-        out << "Set Tempo";
-        break;    
-    case smpte_offset:
-        out << "SMPTE Offset";
-        break;
-    case time_sig:
-        out << "Time Signature";
-        break;    
-    case key_sig:
-        out << "Key Signature";
-        break;
-    case sequencer:
-        out << "Sequencer Specific Event";
-        break;
-    case max_meta:
-        out << "Unidentified MIDI Event";
-        break;
-    }
-
-    return out;
-}
-
 Meta metaEvent(int ff)
 {
     switch(ff)
@@ -140,116 +89,56 @@ int power(int base, int exp)
     return base * power(base, exp - 1);
 }
 
-void sequenceNumber(std::vector<int>& bytes, std::size_t& index)
-{
-    //instantiate short to store sequence number to print
-    short number{};
-
-    number = bytes[index] << 8;
-
-    number |= bytes[++index];
-
-    std::cout << number;
-}
-
-void tempoChange(std::vector<int>& bytes, std::size_t& index)
+//the number of data bytes of a fixed-length meta event, whatever its length byte says
+std::size_t fixedLength(Meta m_event)
 {
-    long long microseconds{};
-
-    microseconds = (static_cast<std::uint8_t>(bytes[index]) << 16);
-
-    microseconds |= (static_cast<std::uint8_t>(bytes[++index]) << 8);
-
-    microseconds |= static_cast<std::uint8_t>(bytes[++index]);
-
-    std::cout << 60 / (double(microseconds) / 1000000) << " BPM";
-}
-
-void smpteOffset(std::vector<int>& bytes, std::size_t& index)
-{
-    std::size_t end { index + 4 };
-
-    for ( index; index < end; ++index )
+    switch(m_event)
     {
-        std::cout << bytes[index] << ':';
+    case seq_num: return 2;
+    case channel: return 1;
+    case set_tempo: return 3;
+    case smpte_offset: return 5;
+    case time_sig: return 4;
+    case key_sig: return 2;
+    default: return 0;
     }
-
-    std::cout << bytes[index];
 }
 
-void timeSignature(std::vector<int>& bytes, std::size_t& index)
+//work out the values of a fixed-length meta event from its data bytes
+void fixedValues(Meta m_event, MetaEvent& e)
 {
-    //increment index again because we only incremented to the length byte before
-    std::cout << bytes[index] << '/' << power(2, bytes[++index]);
-    std::cout << "\n\t" << "MIDI clocks per quarter note: " << bytes[++index];
-    std::cout << "\n\t" << "Number of 32nd notes per 24 MIDI clocks: " << bytes[++index];
-}
-
-void keySignature(std::vector<int>& bytes, std::size_t& index)
-{
-    switch(bytes[index])
-    {
-    case -7:
-        std::cout << "Cb ";
-        break;      
-    case -6:
-        std::cout << "Gb ";
-        break;        
-    case -5:
-        std::cout << "Db ";
-        break;    
-    case -4:
-        std::cout << "Ab ";
-        break;
-    case -3:
-        std::cout << "Eb ";
-        break;
-    case -2:
-        std::cout << "Bb ";
-        break;
-    case -1:
-        std::cout << "F ";
-        break;
-    case 0:
-        std::cout << "C ";
-        break;
-    case 1:
-        std::cout << "G ";
-        break;
-    case 2:
-        std::cout << "D ";
-        break;
-    case 3:
-        std::cout << "A ";
+    switch(m_event)
+    {
+    case seq_num:
+        //a short, as sequence numbers have always been printed
+        e.first = static_cast<short>( e.data[0] << 8 | e.data[1] );
         break;
-    case 4:
-        std::cout << "E ";
+    case channel:
+        e.first = e.data[0];
         break;
-    case 5:
-        std::cout << "B ";
+    case set_tempo:
+    {
+        long long microseconds{ static_cast<std::uint8_t>(e.data[0]) << 16
+                                | static_cast<std::uint8_t>(e.data[1]) << 8
+                                | static_cast<std::uint8_t>(e.data[2]) };
+
+        e.bpm = 60 / (double(microseconds) / 1000000);
         break;
-    case 6:
-        std::cout << "F# ";
+    }
+    case time_sig:
+        e.first = e.data[0];
+        e.second = power(2, e.data[1]);
         break;
-    case 7:
-        std::cout << "C# ";
+    case key_sig:
+        e.first = e.data[0];
+        e.second = ( e.data[1] != 0 );
         break;
     default:
-        std::cout << "??? ";
         break;
     }
-
-    if(bytes[++index])
-    {
-        std::cout << "minor";
-    }
-    else
-    {
-        std::cout << "Major";
-    }
 }
 
-long calculateVariableLength(std::vector<int>& bytes, std::size_t& index)
+long calculateVariableLength(TrackBuffer& bytes, std::size_t& index)
 {
     long vL{};
     int temp{};
@@ -269,23 +158,18 @@ long calculateVariableLength(std::vector<int>& bytes, std::size_t& index)
     return vL;
 }
 
-void printVLEvent(std::vector<int>& bytes, std::size_t& index, long& vL)
+//view the text of a variable-length event and move index past all vL bytes of it;
+//the text ends at its first NUL (some files pad their names with them), but the event doesn't
+std::string_view readVLEvent(TrackBuffer& bytes, std::size_t& index, long vL)
 {
-    std::size_t end { index + vL };
-
-    while ( index < end )
-    {
-        std::cout << char(bytes[index]);
-        ++index;
+    std::string_view text{ bytes.view(index, static_cast<std::size_t>(vL)) };
 
-        if ( bytes[index] == 0 )
-            break;
-    }
+    index += static_cast<std::size_t>(vL);
 
-    std::cout << '\n';
+    return text.substr( 0, text.find('\0') );
 }
 
-void lookahead(std::vector<int>& bytes, std::size_t& index)
+void lookahead(TrackBuffer& bytes, std::size_t& index)
 {
     if ( bytes[index] == 0 )
     {
@@ -304,184 +188,289 @@ void lookahead(std::vector<int>& bytes, std::size_t& index)
     }
 }
 
-bool parseMetaEvent(std::vector<int>& bytes, std::size_t& index)
+//read a meta event into a row, print it in the listing and hand it to the listeners;
+//returns false if the track is over
+bool parseMetaEvent(TrackBuffer& bytes, std::size_t& index, const ParseOptions& options, long tick)
 {
+    MetaEvent e{};
+    e.tick = tick;
+    e.type = bytes[index];
+
     //event is a meta; metaEvent returns the type of meta event
     //that corresponds with the byte immediately following FF
-    Meta m_event{ metaEvent( bytes[index] ) };
+    Meta m_event{ metaEvent( e.type ) };
 
-    std::cout << m_event << ": ";
-
-    //if the meta event is variable length, calculate variable length and print text
+    //if the meta event is variable length, calculate variable length and read text
     if( (m_event > 0 && m_event < 8) || m_event == ( max_meta - 1 ) )
     {
         //increment index to start calculation with the next byte
         long variable_length{ calculateVariableLength(bytes, ++index) };
 
         if ( variable_length > 0 )
-        {
-            printVLEvent(bytes, ++index, variable_length);
-        }
+            e.text = readVLEvent(bytes, ++index, variable_length);
         else
-        {
-            std::cout << '\n';
             ++index;
-        }
-
     }
-    //if the meta event is not variable length, implement the correct fixed-length procedure
-    else
+    //trivial: track is over, we are done (index is left at the length byte)
+    else if ( m_event == end )
     {
-        //increment index to arrive at (fixed) length byte
         ++index;
+    }
+    //if the meta event is not variable length, read as many data bytes as the type has, past the length byte
+    else
+    {
+        std::size_t length{ fixedLength(m_event) };
 
-        //increment index while entering function to start processing after length byte
-        switch( m_event )
-        {
-        case seq_num:
-            sequenceNumber(bytes, ++index);
-            break;
-        case channel:
-            //trivial: print channel byte
-            std::cout << bytes[++index];
-            break;
-        case end:
-            //trivial: track is over, we are done
-            std::cout << "---\n\n";
-            return false;
-        case set_tempo:
-            tempoChange(bytes, ++index);
-            break;
-        case smpte_offset:
-            smpteOffset(bytes, ++index);
-            break;
-        case time_sig:
-            timeSignature(bytes, ++index);
-            break;
-        case key_sig:
-            keySignature(bytes, ++index);
-            break;
-        default:
-            std::cerr << "Cannot recognize meta event.";
-            break;
-        }
+        index += 2;
+
+        for ( std::size_t d{ 0 }; d < length; ++d )
+            e.data[d] = static_cast<signed char>( bytes[index + d] );
+
+        index += length;
+
+        fixedValues(m_event, e);
+
+        if ( m_event == max_meta )
+            *options.err << "Cannot recognize meta event.\n";
+    }
+
+    if ( options.out->rdbuf() )
+        listMetaEvent(*options.out, e);
+
+    for ( auto* l : options.meta_listeners )
+    {
+        l->metaEvent( e );
+    }
+
+    return ( m_event != end );
+}
+
+//move index past a meta event exactly as parseMetaEvent does, without printing it or telling the listeners
+//(nor complaining about unknown ones); returns false if the track is over
+bool skipMetaEvent(TrackBuffer& bytes, std::size_t& index)
+{
+    Meta m_event{ metaEvent( bytes[index] ) };
+
+    if( (m_event > 0 && m_event < 8) || m_event == ( max_meta - 1 ) )
+    {
+        long variable_length{ calculateVariableLength(bytes, ++index) };
+
+        if ( variable_length > 0 )
+            index += 1 + static_cast<std::size_t>(variable_length);
+        else
+            ++index;
 
-        std::cout << '\n';
+        return true;
+    }
 
+    if ( m_event == end )
+    {
         ++index;
+        return false;
+    }
+
+    //the type and length bytes, then the data
+    index += 2 + fixedLength(m_event);
+
+    return true;
+}
+
+//work out the channel, lane and value of a controller change, program change, key/channel pressure or pitch bend;
+//data1 and data2 are the two bytes after the status byte; returns false if it isn't one of them
+bool controlEvent(int status, int data1, int data2, int& channel, int& lane, int& value)
+{
+    if ( data1 < 0 )
+        return false;
+
+    channel = status & 0x0F;
+
+    switch( status & 0xF0 )
+    {
+    case 0xA0:
+        lane = poly_pressure_lane + data1;
+        value = data2;
+        break;
+    case 0xB0:
+        lane = data1;
+        value = data2;
+        break;
+    case 0xC0:
+        lane = program_lane;
+        value = data1;
+        break;
+    case 0xD0:
+        lane = pressure_lane;
+        value = data1;
+        break;
+    case 0xE0:
+        //14-bit value, least significant 7 bits first
+        lane = pitch_bend_lane;
+        value = ( (data2 << 7) | data1 ) - 8192;
+        break;
+    default:
+        return false;
     }
 
     return true;
 }
 
-void parseMIDIEvent(std::vector<int>& bytes, std::size_t& index, NoteVector& noteVector, int& status)
+//hand a controller-type event to the listeners, and work the sustain pedal if notes are being sustained
+void parseControlEvent(NoteVector& noteVector, int status, int data1, int data2, const ParseOptions& options)
+{
+    int channel{};
+    int lane{};
+    int value{};
+
+    if ( !controlEvent( status, data1, data2, channel, lane, value ) )
+        return;
+
+    if ( lane == sustain_pedal && options.sustain )
+    {
+        noteVector.pedal( channel, value >= 64 );
+    }
+
+    for ( auto* l : options.control_listeners )
+    {
+        l->controlChange( noteVector.tick(), channel, lane, value );
+    }
+}
+
+//act on a MIDI event without moving through the track, so events can be read ahead of being acted on;
+//data1 and data2 are the two bytes after the status byte
+void applyMIDIEvent(NoteVector& noteVector, int status, int data1, int data2, const ParseOptions& options)
 {
     char event { status & 0xF0 };
     //if Note On...
     if ( event == char(0x90) )
     {
-        //current index is note number
-        //next index is velocity
+        //data1 is note number
+        //data2 is velocity
 
-        if (bytes[index + 1] > 0)
+        if (data2 > 0)
         {
-            noteVector.addNote( MIDInote{ status, bytes[index] } );
+            MIDInote note{ status, data1 };
+            note.setVelocity( data2 );
+
+            noteVector.addNote( note );
         }
         //else implicit Note Off
         else
         {
-            noteVector.noteOff( status, bytes[index] );
+            noteVector.noteOff( status, data1 );
         }
-
-        //increment index to arrive at velocity byte
-        ++index;
-        //increment again to arrive at next delta byte
-        ++index;
     }
     //if explicit Note Off...
     else if ( event == char(0x80) )
     {
-        noteVector.noteOff( status, bytes[index] );
+        noteVector.noteOff( status, data1 );
+    }
+    //if some other MIDI event, decode controller-type events
+    else if ( event != char(0xF0) )
+    {
+        parseControlEvent( noteVector, status, data1, data2, options );
+    }
+}
 
+//move index from the first data byte of a MIDI event to the next delta time byte
+void skipMIDIEvent(TrackBuffer& bytes, std::size_t& index, int status)
+{
+    char event { static_cast<char>( status & 0xF0 ) };
+
+    //if Note On or Note Off...
+    if ( event == char(0x90) || event == char(0x80) )
+    {
         //increment index to arrive at velocity byte
         ++index;
         //increment again to arrive at next delta byte
         ++index;
+
+        return;
     }
-    //if some other MIDI event...
-    else
-    {
-        //...skip over this data
 
-        //handle voice and mode messages
-        //in higher level switch
+    //handle voice and mode messages
+    //in higher level switch
+
+    switch(event)
+    {
+    case char(0xA0): [[fallthrough]];
+    case char(0xB0): [[fallthrough]];
+    case char(0xE0):
+        //increment index to arrive at
+        //second data byte
+        ++index;
+        [[fallthrough]];
+    case char(0xC0): [[fallthrough]];
+    case char(0xD0): [[fallthrough]];
+    case char(0xF0):
+        //increment delta to arrive at
+        //next delta time byte
+        lookahead(bytes, index);
+        break;
+   //handle system messages in default
+    default:
+        char def { status & 0x0F };
 
-        switch(event)
+        switch(def)
         {
-        case char(0xA0): [[fallthrough]];
-        case char(0xB0): [[fallthrough]];
-        case char(0xE0):
+        case (0x02):
             //increment index to arrive at
             //second data byte
             ++index;
             [[fallthrough]];
-        case char(0xC0): [[fallthrough]];
-        case char(0xD0): [[fallthrough]];
-        case char(0xF0):
-            //increment delta to arrive at
+        case (0x03):
+            //increment to arrive at
             //next delta time byte
             lookahead(bytes, index);
-            break;
-       //handle system messages in default
+            [[fallthrough]];
         default:
-            char def { status & 0x0F };
-
-            switch(def)
-            {
-            case (0x02):
-                //increment index to arrive at
-                //second data byte
-                ++index;
-                [[fallthrough]];
-            case (0x03):
-                //increment to arrive at
-                //next delta time byte
-                lookahead(bytes, index);
-                [[fallthrough]];
-            default:
-                //there are no data bytes,
-                //so index is already at
-                //next delta time byte
-                break;
-            }
+            //there are no data bytes,
+            //so index is already at
+            //next delta time byte
+            break;
         }
     }
 }
 
-void parseSingleTrack(std::vector<int>& bytes, short quarter_note)
+void parseMIDIEvent(TrackBuffer& bytes, std::size_t& index, NoteVector& noteVector, int& status, const ParseOptions& options)
 {
-    //store MIDI notes in NoteVector class
-    NoteVector noteVector{};
+    applyMIDIEvent( noteVector, status, bytes[index], bytes[index + 1], options );
 
+    skipMIDIEvent( bytes, index, status );
+}
+
+//walk the events of a track from index, which must be the start of an event, until the end of the track
+//or the first event that starts at or after stop; returns the index the walk stopped at
+//
+//where the walk goes depends only on the bytes and the index it starts from, so two walks that reach the start
+//of the same event go the same way from there on; what is done with the events is up to the decoder:
+//    bool step(bytes, index, boundary)   at every byte the walk stops at; returning false ends the walk
+//    void midi(bytes, index, status)     a MIDI event, with index at its first data byte
+//    bool meta(bytes, index)             a meta event, with index at its type byte; moves index to the delta time
+//                                        after it, and returns false if the track is over
+//    void sysex()                        a system exclusive event
+//    void delta(delta)                   the delta time after every event
+template <typename Decoder>
+std::size_t walkTrack(TrackBuffer& bytes, std::size_t index, std::size_t stop, Decoder& decoder)
+{
     //store delta time in an int
     int delta{ 0 };
 
-    //store status byte in an int 
+    //store status byte in an int
     int status{};
 
-    std::size_t index{};
+    //whether index is at the start of an event
+    bool boundary{ true };
 
-    for ( std::size_t begindex{}; begindex < std::size(bytes); ++begindex )
+    for ( ; bytes.has(index); ++index )
     {
-        if (bytes[begindex] == char(0xFF) )
-        {
-            index = begindex;
+        if ( boundary && index >= stop )
             break;
-        }
-    }
 
-    for ( index; index < std::size(bytes); ++index )
-    {
+        if ( !decoder.step(bytes, index, boundary) )
+            break;
+
+        boundary = false;
+
         //interpret status byte
         //
         //if this is a system exclusive event...
@@ -493,13 +482,12 @@ void parseSingleTrack(std::vector<int>& bytes, short quarter_note)
             //... just skip through all of this data
             while ( index < end )
                 ++index;
-            
+
+            decoder.sysex();
+
             delta = calculateVariableLength(bytes, index);
-            
-            if (delta > 0)
-            {
-                noteVector.addDelta( delta );
-            }
+            decoder.delta( delta );
+            boundary = true;
 
             continue;
         }
@@ -525,91 +513,592 @@ void parseSingleTrack(std::vector<int>& bytes, short quarter_note)
         //parse meta events
         if ( status == char(0xFF) )
         {
-            noteVector.printNotes( quarter_note );
-
-            if( parseMetaEvent(bytes, index) )
-            {
-                //index is at the next delta time byte
-                delta = calculateVariableLength(bytes, index);
-
-                if (delta > 0)
-                {
-                    noteVector.addDelta( delta );
-                }
-
-                continue;
-            }
-            else
-            {
+            if ( !decoder.meta(bytes, index) )
                 break;
-            }
         }
         //parse MIDI events
         else
         {
-            parseMIDIEvent( bytes, index, noteVector, status );
+            decoder.midi( bytes, index, status );
 
-            //index is at the next delta time byte
-            delta = calculateVariableLength(bytes, index);
+            skipMIDIEvent( bytes, index, status );
+        }
 
-            if (delta > 0)
-            {
-                noteVector.addDelta( delta );
-            }
+        //index is at the next delta time byte
+        delta = calculateVariableLength(bytes, index);
+        decoder.delta( delta );
+        boundary = true;
+    }
+
+    return index;
+}
+
+//tell the listeners that a new track has started
+
+void startTrack(const ParseOptions& options)
+{
+    for ( auto* l : options.listeners )
+    {
+        l->trackStarted();
+    }
+
+    for ( auto* l : options.control_listeners )
+    {
+        l->trackStarted();
+    }
+}
+
+//create class to act on the events of a track: printing them, keeping its notes and telling the listeners
+
+class TrackDecoder
+{
+public:
+    TrackDecoder(short quarter_note, const ParseOptions& options)
+        : m_quarter_note{ quarter_note }
+        , m_options{ options }
+        , m_notes{ *options.out }
+    {
+        startTrack( options );
+
+        for ( auto* l : options.listeners )
+        {
+            m_notes.addListener( l );
+        }
+    }
+
+    bool step(TrackBuffer& bytes, std::size_t index, bool);
+
+    void midi(TrackBuffer& bytes, std::size_t index, int status)
+    {
+        applyMIDIEvent( m_notes, status, bytes[index], bytes[index + 1], m_options );
+    }
+
+    bool meta(TrackBuffer& bytes, std::size_t& index)
+    {
+        m_notes.printNotes( m_quarter_note );
+
+        return parseMetaEvent( bytes, index, m_options, m_notes.tick() );
+    }
+
+    void sysex() {}
+
+    void delta(int delta)
+    {
+        if (delta > 0)
+        {
+            m_notes.addDelta( delta );
+        }
+    }
+
+    //print and hand over the notes left at the end of the track
+    void finish()
+    {
+        m_notes.printNotes( m_quarter_note );
+
+        m_notes.flush();
+
+        //the listing of a note tied to fit under the limit stops at the tie, so it isn't what an unbounded parse prints
+        if ( m_tied > 0 )
+        {
+            *m_options.err << "Warning: " << m_tied << " held notes were printed tied to stay under the memory limit; "
+                           << "the rest of their lengths isn't listed\n";
         }
     }
 
-    noteVector.printNotes( quarter_note );
+    //whether the track went over the memory limit
+    bool failed() const { return m_failed; }
+
+private:
+    short m_quarter_note{};
+    const ParseOptions& m_options;
+
+    //store MIDI notes in NoteVector class
+    NoteVector m_notes;
+
+    bool m_failed{ false };
+
+    //notes printed tied by step() before a meta event or the end of the track could tie them
+    std::size_t m_tied{ 0 };
+};
+
+//in bounded-memory mode, let go of input and notes that aren't needed anymore
+bool TrackDecoder::step(TrackBuffer& bytes, std::size_t index, bool)
+{
+    if ( !m_options.memory )
+        return true;
+
+    bytes.release( index );
+
+    auto usage{ [&]() { return bytes.memoryUsage() + m_notes.memoryUsage(); } };
+
+    if ( usage() > m_options.memory->limit() )
+    {
+        m_notes.emitFinished( m_quarter_note );
+    }
+
+    //a note held since before the notes that have finished keeps them all waiting to be printed,
+    //so only when it must, print it tied, and keep no more than the notes still on
+    if ( usage() > m_options.memory->limit() )
+    {
+        m_tied += m_notes.emitFinished( m_quarter_note, true );
+    }
+
+    if ( !m_options.memory->record( usage() ) )
+    {
+        *m_options.err << "Error: track exceeds memory limit of " << m_options.memory->limit() << " bytes\n";
+
+        m_failed = true;
+    }
+
+    return !m_failed;
 }
 
-void parseTracks(std::ifstream& inf, short quarter_note)
+//create struct to hold what decoding one segment of a track found, with ticks counted from the start of the segment,
+//so the segments can be decoded at the same time and handed to the listeners one after another;
+//a note takes 30 bytes (24, 4 in finished and 2 in order), a controller-type event 17
+
+struct SegmentResult
 {
-    //store track bytes in vector
-    std::vector<int> bytes{};
+    enum Kind : std::uint8_t
+    {
+        start,
+        finish,
+        key_off,
+        meta,
+        control
+    };
+
+    //pitch and velocity are kept as the parser reads them (signed bytes), so notes come out the same
+    struct Note
+    {
+        long onset{};
+
+        //-1 while the note is still on at the end of the segment
+        long end{ -1 };
 
-    //iterate through bytes with char
-    char c;
+        signed char channel{};
+        signed char pitch{};
+        signed char velocity{};
+    };
 
-    bool e_gate { false };
-    bool p_gate { false };
+    //the first note off of a channel and pitch in the segment, which turns off every note of it carried over
+    //from the segments before
+    struct KeyOff
+    {
+        long tick{};
+        int channel{};
+        int pitch{};
+    };
 
-    while (inf >> c)
+    //meta events are parsed again when they are handed over, from the index of their type byte
+    struct Meta
     {
-        if( p_gate )
+        long tick{};
+        std::size_t type_index{};
+    };
+
+    struct Control
+    {
+        long tick{};
+        std::int16_t lane{};
+        std::int16_t value{};
+        signed char channel{};
+    };
+
+    //the order of every event that calls a listener; each kind takes the next entry of its own vector,
+    //except finish, which takes the next note index in finished
+    std::vector<Kind> order{};
+
+    std::vector<Note> notes{};
+    std::vector<std::uint32_t> finished{};
+    std::vector<KeyOff> key_offs{};
+    std::vector<Meta> metas{};
+    std::vector<Control> controls{};
+
+    //ticks in the segment, including the delta time after its last event
+    long ticks{ 0 };
+
+    //where the walk stopped, and whether it was at the end of the track
+    std::size_t stop{};
+    bool ended{ false };
+};
+
+//create class to decode a segment of a track into a SegmentResult, without printing anything
+//(the sustain pedal isn't followed, so notes end at their note offs)
+
+class SegmentDecoder
+{
+public:
+    explicit SegmentDecoder(SegmentResult& result)
+        : m_result{ result }
+    {
+    }
+
+    bool step(TrackBuffer&, std::size_t, bool) { return true; }
+
+    void midi(TrackBuffer& bytes, std::size_t index, int status);
+
+    bool meta(TrackBuffer& bytes, std::size_t& index);
+
+    void sysex() {}
+
+    void delta(int delta)
+    {
+        if (delta > 0)
         {
-            bytes.push_back( int(c) );
+            m_result.ticks += delta;
+        }
+    }
 
-            parseSingleTrack(bytes, quarter_note);
-            
-            //erase everything from the bytes vector
-            bytes.erase( bytes.begin(), bytes.begin() + std::size(bytes) );
+private:
+    void noteOff(int channel, int pitch);
 
-            p_gate = false;
+    SegmentResult& m_result;
 
-            continue;
+    //indices in the result's notes of the notes that are still on, in order
+    std::vector<std::uint32_t> m_sounding{};
+
+    //channels and pitches (as unsigned bytes) that have had a note off in the segment
+    std::bitset<16 * 256> m_released{};
+};
+
+//decode a MIDI event the way applyMIDIEvent does
+void SegmentDecoder::midi(TrackBuffer& bytes, std::size_t index, int status)
+{
+    int data1{ bytes[index] };
+    int data2{ bytes[index + 1] };
+    int event{ status & 0xF0 };
+
+    if ( event == 0x90 && data2 > 0 )
+    {
+        m_sounding.push_back( static_cast<std::uint32_t>( std::size(m_result.notes) ) );
+
+        m_result.notes.push_back( SegmentResult::Note{ m_result.ticks, -1, static_cast<signed char>( status & 0x0F ),
+                                                       static_cast<signed char>(data1), static_cast<signed char>(data2) } );
+        m_result.order.push_back( SegmentResult::start );
+    }
+    else if ( event == 0x90 || event == 0x80 )
+    {
+        noteOff( status & 0x0F, data1 );
+    }
+    else if ( event != 0xF0 )
+    {
+        int channel{};
+        int lane{};
+        int value{};
+
+        if ( controlEvent( status, data1, data2, channel, lane, value ) )
+        {
+            m_result.controls.push_back( SegmentResult::Control{ m_result.ticks, static_cast<std::int16_t>(lane),
+                                                                 static_cast<std::int16_t>(value), static_cast<signed char>(channel) } );
+            m_result.order.push_back( SegmentResult::control );
+        }
+    }
+}
+
+//turn off every note of a channel and pitch, like NoteVector::noteOff: the ones carried over from the segments
+//before (which the first note off of the segment does) and then the segment's own ones
+void SegmentDecoder::noteOff(int channel, int pitch)
+{
+    std::size_t key{ static_cast<std::size_t>( channel * 256 + (pitch & 0xFF) ) };
+
+    if ( !m_released[key] )
+    {
+        m_released[key] = true;
+
+        m_result.key_offs.push_back( SegmentResult::KeyOff{ m_result.ticks, channel, pitch } );
+        m_result.order.push_back( SegmentResult::key_off );
+    }
+
+    bool released{ false };
+
+    for ( std::uint32_t i : m_sounding )
+    {
+        SegmentResult::Note& n{ m_result.notes[i] };
+
+        if ( n.channel == channel && n.pitch == pitch )
+        {
+            n.end = m_result.ticks;
+
+            m_result.finished.push_back( i );
+            m_result.order.push_back( SegmentResult::finish );
+
+            released = true;
+        }
+    }
+
+    if ( released )
+    {
+        m_sounding.erase( std::remove_if( m_sounding.begin(), m_sounding.end(),
+                                          [this](std::uint32_t i) { return m_result.notes[i].end >= 0; } ),
+                          m_sounding.end() );
+    }
+}
+
+bool SegmentDecoder::meta(TrackBuffer& bytes, std::size_t& index)
+{
+    m_result.metas.push_back( SegmentResult::Meta{ m_result.ticks, index } );
+    m_result.order.push_back( SegmentResult::meta );
+
+    //meta events are parsed (and printed, or complained about) when they are handed over
+    m_result.ended = !skipMetaEvent( bytes, index );
+
+    return !m_result.ended;
+}
+
+//hand what a segment decoded to the listeners, with its ticks counted from offset; carried holds the notes still on
+//from the segments before it, in the order they started, and is left holding the ones still on after it;
+//returns false if the segment ended the track
+bool replaySegment(TrackBuffer& bytes, const SegmentResult& result, long offset, std::vector<MIDInote>& carried,
+                   const ParseOptions& options)
+{
+    std::size_t note{ 0 };
+    std::size_t finished{ 0 };
+    std::size_t key_off{ 0 };
+    std::size_t meta{ 0 };
+    std::size_t control{ 0 };
+
+    bool ended{ false };
+
+    auto toNote{ [&](const SegmentResult::Note& n)
+    {
+        MIDInote m{ n.channel, n.pitch };
+        m.setVelocity( n.velocity );
+        m.setOnset( offset + n.onset );
+
+        return m;
+    } };
+
+    for ( auto kind : result.order )
+    {
+        if ( ended )
+            break;
+
+        switch ( kind )
+        {
+        case SegmentResult::start:
+        {
+            MIDInote m{ toNote( result.notes[note++] ) };
+
+            for ( auto* l : options.listeners )
+                l->noteStarted( m );
+
+            break;
         }
+        case SegmentResult::finish:
+        {
+            const SegmentResult::Note& n{ result.notes[ result.finished[finished++] ] };
+
+            MIDInote m{ toNote(n) };
+            m.holdUntil( offset + n.end );
+            m.turnOff();
+
+            for ( auto* l : options.listeners )
+                l->noteFinished( m );
 
-        if ( e_gate )
+            break;
+        }
+        case SegmentResult::key_off:
         {
-            if ( c == char(0x2F) )
+            const SegmentResult::KeyOff& k{ result.key_offs[key_off++] };
+
+            for ( auto& m : carried )
             {
-                p_gate = true;
+                if ( m.channel() == k.channel && m.getPitch().MIDInote() == k.pitch )
+                {
+                    m.holdUntil( offset + k.tick );
+                    m.turnOff();
+
+                    for ( auto* l : options.listeners )
+                        l->noteFinished( m );
+                }
             }
 
-            e_gate = false;
+            carried.erase( std::remove_if( carried.begin(), carried.end(), [](const MIDInote& m) { return !m.isOn(); } ),
+                           carried.end() );
+            break;
         }
+        case SegmentResult::meta:
+        {
+            const SegmentResult::Meta& e{ result.metas[meta++] };
+            std::size_t index{ e.type_index };
+
+            ended = !parseMetaEvent( bytes, index, options, offset + e.tick );
 
-        if( c == char(0xFF) )
+            break;
+        }
+        case SegmentResult::control:
         {
-            e_gate = true;
+            const SegmentResult::Control& c{ result.controls[control++] };
+
+            for ( auto* l : options.control_listeners )
+                l->controlChange( offset + c.tick, c.channel, c.lane, c.value );
+
+            break;
         }
+        }
+    }
 
-        //until we're at a new track, keep adding bytes to the vector
-        bytes.push_back( int(c) );
+    for ( const auto& n : result.notes )
+    {
+        if ( n.end < 0 )
+            carried.push_back( toNote(n) );
     }
 
-    std::cout << '\n';
+    return !ended;
+}
+
+//look for the start of an event at or after index: a channel status byte
+//that follows the last byte of a delta time and is followed by a data byte
+std::size_t guessEventStart(TrackBuffer& bytes, std::size_t index)
+{
+    for ( ; bytes.has(index + 1); ++index )
+    {
+        if ( bytes[index] < char(0xF0) && bytes[index - 1] >= 0 && bytes[index + 1] >= 0 )
+            return index;
+    }
+
+    return index;
+}
+
+//decode a whole track (already read) in segments: every segment but the first is decoded on its own thread
+//from a guessed event start, then the segments are handed to the listeners in order; the walk of the segment
+//before a guess stops at the first event at or after it, so if it doesn't stop right at the guess,
+//the guess was wrong and that segment is decoded again from where it did stop
+void decodeSegments(TrackBuffer& bytes, std::size_t index, std::size_t segments, const ParseOptions& options)
+{
+    std::size_t size{ bytes.size() };
+
+    std::vector<std::size_t> starts{ index };
+
+    for ( std::size_t s{ 1 }; s < segments; ++s )
+    {
+        std::size_t guess{ guessEventStart( bytes, index + (size - index) / segments * s ) };
+
+        if ( guess > starts.back() && guess < size )
+            starts.push_back( guess );
+    }
+
+    std::size_t count{ std::size(starts) };
+
+    std::vector<SegmentResult> results( count );
+
+    auto decode{ [&](std::size_t s, std::size_t from)
+    {
+        results[s] = SegmentResult{};
+
+        SegmentDecoder decoder{ results[s] };
+
+        results[s].stop = walkTrack( bytes, from, ( s + 1 < count ) ? starts[s + 1] : std::size_t(-1), decoder );
+    } };
+
+    std::vector<std::thread> threads{};
+
+    for ( std::size_t s{ 1 }; s < count; ++s )
+    {
+        threads.emplace_back( decode, s, starts[s] );
+    }
+
+    decode( 0, starts[0] );
+
+    for ( auto& t : threads )
+        t.join();
+
+    std::vector<MIDInote> carried{};
+    long offset{ 0 };
 
-    //if we're at the end of the MIDI file, parse the most-recently stored track
-    parseSingleTrack(bytes, quarter_note);
-}
\ No newline at end of file
+    //where the walk that is known to be right has got to
+    std::size_t reached{ starts[0] };
+
+    for ( std::size_t s{ 0 }; s < count; ++s )
+    {
+        if ( reached != starts[s] )
+            decode( s, reached );
+
+        bool ended{ !replaySegment( bytes, results[s], offset, carried, options ) || results[s].ended };
+
+        offset += results[s].ticks;
+        reached = results[s].stop;
+
+        //let go of each segment once it has been handed over
+        results[s] = SegmentResult{};
+
+        if ( ended )
+            break;
+    }
+
+    //hand over the notes still on at the end of the track, as NoteVector::flush does
+    for ( auto& m : carried )
+    {
+        m.holdUntil( offset );
+
+        for ( auto* l : options.listeners )
+            l->noteFinished( m );
+    }
+}
+
+bool parseSingleTrack(TrackBuffer& bytes, short quarter_note, const ParseOptions& options)
+{
+    std::size_t index{};
+
+    for ( std::size_t begindex{}; bytes.has(begindex); ++begindex )
+    {
+        if (bytes[begindex] == char(0xFF) )
+        {
+            index = begindex;
+            break;
+        }
+    }
+
+    //segments are decoded without printing or following the sustain pedal (see ParseOptions::segments);
+    //the whole track has been read unless memory is bounded
+    bool parallel{ !options.memory && !options.sustain && !options.out->rdbuf() };
+
+    std::size_t segments{ parallel ? std::min( options.segments, bytes.size() / min_segment ) : 1 };
+
+    if ( segments > 1 )
+    {
+        startTrack( options );
+
+        decodeSegments( bytes, index, segments, options );
+
+        return true;
+    }
+
+    TrackDecoder decoder{ quarter_note, options };
+
+    walkTrack( bytes, index, std::size_t(-1), decoder );
+
+    if ( decoder.failed() )
+        return false;
+
+    decoder.finish();
+
+    return true;
+}
+
+bool parseTracks(std::istream& inf, short quarter_note, const ParseOptions& options)
+{
+    std::size_t window{ options.memory ? input_window : 0 };
+
+    for ( auto* l : options.listeners )
+    {
+        l->setDivision( quarter_note );
+    }
+
+    while ( true )
+    {
+        //store track bytes in buffer; it reads up to the end of the track
+        TrackBuffer bytes{ inf, window };
+
+        if ( bytes.empty() )
+            break;
+
+        if ( !parseSingleTrack(bytes, quarter_note, options) )
+            return false;
+    }
+
+    *options.out << '\n';
+
+    return true;
+}